@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+//boundary between label rid and label nb_rid, seen from rid's side
+struct LabelPairBoundary {
+	int rid, nb_rid;
+	int edge_cnt;		//(pixel of rid, 8-neighbor of nb_rid) pairs
+	int pix_cnt;		//pixels of rid that have at least one 8-neighbor of nb_rid
+};
+
+struct LabelBoundaryInfo {
+	vector<int>					perimeter;		//8-neighbors with a different label, including those outside the image
+	vector<int>					outside_cnt;	//8-neighbors outside the image
+	vector<LabelPairBoundary>	pairs;			//sorted by (rid, nb_rid), every pair is present in both directions
+	vector<int>					pair_offsets;	//pairs of rid are pairs[pair_offsets[rid]] ... pairs[pair_offsets[rid + 1] - 1]
+	vector<uint8_t>				boundary_mask;	//1 if a pixel has an 8-neighbor inside the image with a different label
+
+	bool TouchesImageBorder(int rid) const {
+		return outside_cnt[rid] > 0;
+	}
+
+	//visit rid's neighbors in increasing id order with their shared edge count,
+	//neighbors outside the image are counted as label 0 (the canvas)
+	template<typename Func>
+	void ForEachNeighborOf(int rid, Func f) const {
+		int k = pair_offsets[rid], end = pair_offsets[rid + 1];
+		int outside = outside_cnt[rid];
+		if (outside > 0 && (k == end || pairs[k].nb_rid != 0)) {
+			f(0, outside);
+			outside = 0;
+		}
+		for (; k < end; k++) {
+			if (pairs[k].nb_rid == 0) f(0, pairs[k].edge_cnt + outside);
+			else f(pairs[k].nb_rid, pairs[k].edge_cnt);
+		}
+	}
+};
+
+//One raster pass over a label map that finds perimeters, pairwise boundary counts and boundary pixels.
+//Each band of rows keeps a window of three row pointers and its own counters, which are merged at the end.
+template<typename Label>
+LabelBoundaryInfo ScanLabelBoundaries(const Label* labels, int h, int w, int label_cnt) {
+	int band_cnt = 1;
+#ifdef _OPENMP
+	band_cnt = max(1, min(omp_get_max_threads(), h / 16));
+#endif
+	const int r_[8] = { -1,0,1,0,-1,1,-1,1 };
+	const int c_[8] = { 0,1,0,-1,-1,1,1,-1 };
+
+	LabelBoundaryInfo info;
+	info.boundary_mask.assign((size_t)h * w, 0);
+
+	vector<unordered_map<uint64_t, pair<int, int>>> band_pairs(band_cnt);
+	vector<vector<int>> band_perimeter(band_cnt, vector<int>(label_cnt, 0));
+	vector<vector<int>> band_outside(band_cnt, vector<int>(label_cnt, 0));
+
+#pragma omp parallel for schedule(static, 1)
+	for (int b = 0; b < band_cnt; b++) {
+		unordered_map<uint64_t, pair<int, int>>& pair_cnt = band_pairs[b];
+		vector<int>& perimeter = band_perimeter[b];
+		vector<int>& outside_cnt = band_outside[b];
+		int row_begin = (int)((int64_t)h * b / band_cnt);
+		int row_end = (int)((int64_t)h * (b + 1) / band_cnt);
+
+		for (int r = row_begin; r < row_end; r++) {
+			const Label* rows[3] = {
+				r > 0 ? labels + (size_t)(r - 1) * w : nullptr,
+				labels + (size_t)r * w,
+				r + 1 < h ? labels + (size_t)(r + 1) * w : nullptr
+			};
+			for (int c = 0; c < w; c++) {
+				Label a = rows[1][c];
+				Label nb[8];
+				int occ[8];
+				int nb_n = 0, diff_n = 0, outside = 0;
+				for (int k = 0; k < 8; k++) {
+					const Label* row = rows[1 + r_[k]];
+					int new_c = c + c_[k];
+					if (!row || new_c < 0 || new_c >= w) {
+						outside++;
+						continue;
+					}
+					Label l = row[new_c];
+					if (l == a) continue;
+					diff_n++;
+					int j = 0;
+					while (j < nb_n && nb[j] != l) j++;
+					if (j == nb_n) nb[nb_n] = l, occ[nb_n++] = 0;
+					occ[j]++;
+				}
+				if (diff_n == 0 && outside == 0) continue;
+
+				perimeter[a] += diff_n + outside;
+				outside_cnt[a] += outside;
+				if (diff_n == 0) continue;
+
+				info.boundary_mask[(size_t)r * w + c] = 1;
+				for (int j = 0; j < nb_n; j++) {
+					pair<int, int>& cnt = pair_cnt[(uint64_t)a << 32 | (uint32_t)nb[j]];
+					cnt.first += occ[j];
+					cnt.second++;
+				}
+			}
+		}
+	}
+
+	//merge the bands' counters
+	info.perimeter.assign(label_cnt, 0);
+	info.outside_cnt.assign(label_cnt, 0);
+	for (int b = 0; b < band_cnt; b++) {
+		for (int l = 0; l < label_cnt; l++) {
+			info.perimeter[l] += band_perimeter[b][l];
+			info.outside_cnt[l] += band_outside[b][l];
+		}
+	}
+	unordered_map<uint64_t, pair<int, int>>& merged = band_pairs[0];
+	for (int b = 1; b < band_cnt; b++) {
+		for (auto& kv : band_pairs[b]) {
+			pair<int, int>& cnt = merged[kv.first];
+			cnt.first += kv.second.first;
+			cnt.second += kv.second.second;
+		}
+	}
+
+	info.pairs.reserve(merged.size());
+	for (auto& kv : merged)
+		info.pairs.push_back({ (int)(kv.first >> 32), (int)(uint32_t)kv.first, kv.second.first, kv.second.second });
+	sort(info.pairs.begin(), info.pairs.end(), [](const LabelPairBoundary& p1, const LabelPairBoundary& p2) {
+		return p1.rid != p2.rid ? p1.rid < p2.rid : p1.nb_rid < p2.nb_rid;
+	});
+
+	info.pair_offsets.assign(label_cnt + 1, 0);
+	for (const LabelPairBoundary& p : info.pairs)
+		info.pair_offsets[p.rid + 1]++;
+	for (int l = 0; l < label_cnt; l++)
+		info.pair_offsets[l + 1] += info.pair_offsets[l];
+	return info;
+}
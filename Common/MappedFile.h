@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+//a whole file mapped read-only; pages are read from disk when first touched and can be dropped by the
+//OS again, so the resident part is what was accessed recently rather than the file size
+class MappedFile {
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = NULL;
+#else
+	int m_fd = -1;
+#endif
+
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+
+	bool Open(string path) {
+		Close();
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) { Close(); return false; }
+		m_size = (size_t)size.QuadPart;
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!m_mapping) { Close(); return false; }
+		m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!m_data) { Close(); return false; }
+#else
+		m_fd = open(path.c_str(), O_RDONLY);
+		if (m_fd == -1) return false;
+		struct stat st;
+		if (fstat(m_fd, &st) != 0 || st.st_size == 0) { Close(); return false; }
+		m_size = (size_t)st.st_size;
+		void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+		if (p == MAP_FAILED) { m_size = 0; Close(); return false; }
+		m_data = (const char*)p;
+#endif
+		return true;
+	}
+
+	void Close() {
+#ifdef _WIN32
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mapping) CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+		m_mapping = NULL;
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_data) munmap((void*)m_data, m_size);
+		if (m_fd != -1) close(m_fd);
+		m_fd = -1;
+#endif
+		m_data = nullptr;
+		m_size = 0;
+	}
+};
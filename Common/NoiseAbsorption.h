@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+//Merge every label with at most max_noise_size pixels into the adjacent larger label whose touching pixel is
+//closest in color (color_diff(pid, nb_pid)), or into label 0 if no larger label touches it.
+//The merges are recorded in a remap table and applied with a single compaction pass:
+//the kept labels are renumbered 1..n in their original order and labels is rewritten in place.
+//Returns the table old label -> new label (label_cnt entries, label 0 stays 0).
+template<typename ColorDiff>
+vector<int> AbsorbNoiseRegions(vector<int>& labels, int h, int w, int label_cnt, int max_noise_size, ColorDiff color_diff) {
+	const int r_[8] = { -1,0,1,0,-1,1,-1,1 };
+	const int c_[8] = { 0,1,0,-1,-1,1,1,-1 };
+
+	vector<int> pix_cnts(label_cnt, 0);
+	for (size_t i = 0; i < labels.size(); i++)
+		pix_cnts[labels[i]]++;
+	auto is_noise = [&](int l) { return l != 0 && pix_cnts[l] <= max_noise_size; };
+
+	//1. find the closest larger neighbor of each noise label===================
+	vector<int> remap(label_cnt);
+	vector<double> min_diff(label_cnt, 1e8);
+	for (int l = 0; l < label_cnt; l++)
+		remap[l] = is_noise(l) ? 0 : l;
+
+	for (int r = 0; r < h; r++) {
+		for (int c = 0; c < w; c++) {
+			int pid = r * w + c;
+			int l = labels[pid];
+			if (!is_noise(l)) continue;
+			for (int k = 0; k < 8; k++) {
+				int new_r = r + r_[k], new_c = c + c_[k];
+				if (new_r < 0 || new_r >= h || new_c < 0 || new_c >= w) continue;
+				int nb_pid = new_r * w + new_c;
+				int nb_l = labels[nb_pid];
+				if (nb_l == l || nb_l == 0 || is_noise(nb_l)) continue;
+				double diff = color_diff(pid, nb_pid);
+				if (diff < min_diff[l]) {
+					min_diff[l] = diff;
+					remap[l] = nb_l;
+				}
+			}
+		}
+	}
+
+	//2. compact the kept labels and relabel the pixels=========================
+	vector<int> new_labels(label_cnt, 0);
+	int kept_cnt = 0;
+	for (int l = 1; l < label_cnt; l++)
+		if (remap[l] == l) new_labels[l] = ++kept_cnt;
+	for (int l = 1; l < label_cnt; l++)
+		if (remap[l] != l) new_labels[l] = new_labels[remap[l]];
+
+#pragma omp parallel for
+	for (int64_t i = 0; i < (int64_t)labels.size(); i++)
+		labels[i] = new_labels[labels[i]];
+	return new_labels;
+}
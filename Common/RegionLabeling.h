@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+struct LabelRun {
+	int row, col_begin, col_end;	//[col_begin, col_end)
+};
+
+inline int FindRunRoot(vector<int>& parent, int i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+//link the larger root to the smaller one, so a set's root is its first run in raster order
+inline void UnionRuns(vector<int>& parent, int i, int j) {
+	i = FindRunRoot(parent, i);
+	j = FindRunRoot(parent, j);
+	if (i < j) parent[j] = i;
+	else if (j < i) parent[i] = j;
+}
+
+//Two-pass, run-based connected component labeling with 8-connectivity.
+//is_fg(pid): pixel takes part in labeling; is_similar(pid1, pid2): two neighboring pixels belong to the same region.
+//Runs are extracted per row, unioned inside horizontal strips in parallel and then across strip borders.
+//labels gets 0 for background and 1..n numbered by the first pixel of each region in raster order, n is returned.
+template<typename IsFg, typename IsSimilar>
+int LabelConnectedRegions(int h, int w, IsFg is_fg, IsSimilar is_similar, vector<int>& labels) {
+	//1. extract the runs of each row===========================================
+	vector<vector<LabelRun>> row_runs(h);
+#pragma omp parallel for schedule(dynamic, 16)
+	for (int r = 0; r < h; r++) {
+		int pid0 = r * w;
+		for (int c = 0; c < w; c++) {
+			if (!is_fg(pid0 + c)) continue;
+			int begin = c;
+			while (c + 1 < w && is_fg(pid0 + c + 1) && is_similar(pid0 + c, pid0 + c + 1)) c++;
+			row_runs[r].push_back({ r, begin, c + 1 });
+		}
+	}
+
+	vector<int> row_offsets(h + 1, 0);
+	for (int r = 0; r < h; r++)
+		row_offsets[r + 1] = row_offsets[r] + row_runs[r].size();
+	vector<LabelRun> runs(row_offsets[h]);
+	for (int r = 0; r < h; r++)
+		copy(row_runs[r].begin(), row_runs[r].end(), runs.begin() + row_offsets[r]);
+	row_runs.clear();
+
+	vector<int> parent(runs.size());
+	for (int i = 0; i < parent.size(); i++) parent[i] = i;
+
+	//connect the runs of row r with the touching runs of row r - 1
+	auto connect_rows = [&](int r) {
+		int j = row_offsets[r - 1];
+		for (int i = row_offsets[r]; i < row_offsets[r + 1]; i++) {
+			const LabelRun& a = runs[i];
+			while (j < row_offsets[r] && runs[j].col_end < a.col_begin) j++;
+			for (int k = j; k < row_offsets[r] && runs[k].col_begin <= a.col_end; k++) {
+				const LabelRun& b = runs[k];
+				int c_begin = max(a.col_begin, b.col_begin - 1);
+				int c_end = min(a.col_end, b.col_end + 1);
+				bool connected = false;
+				for (int c = c_begin; c < c_end && !connected; c++) {
+					for (int nb_c = max(c - 1, b.col_begin); nb_c <= min(c + 1, b.col_end - 1); nb_c++) {
+						if (is_similar(r * w + c, (r - 1) * w + nb_c)) {
+							connected = true;
+							break;
+						}
+					}
+				}
+				if (connected) UnionRuns(parent, i, k);
+			}
+		}
+	};
+
+	//2. union inside strips, then across the strips' borders=================
+	int strip_cnt = 1;
+#ifdef _OPENMP
+	strip_cnt = max(1, min(omp_get_max_threads(), h / 32));
+#endif
+	vector<int> strip_rows(strip_cnt + 1);
+	for (int s = 0; s <= strip_cnt; s++)
+		strip_rows[s] = (int)((int64_t)h * s / strip_cnt);
+
+#pragma omp parallel for schedule(static, 1)
+	for (int s = 0; s < strip_cnt; s++)
+		for (int r = strip_rows[s] + 1; r < strip_rows[s + 1]; r++)
+			connect_rows(r);
+
+	for (int s = 1; s < strip_cnt; s++)
+		connect_rows(strip_rows[s]);
+
+	//3. number the regions in raster order and write the labels================
+	vector<int> run_label(runs.size(), 0);
+	int region_cnt = 0;
+	for (int i = 0; i < runs.size(); i++) {
+		int root = FindRunRoot(parent, i);
+		run_label[i] = (root == i) ? ++region_cnt : run_label[root];
+	}
+
+	labels.assign((size_t)h * w, 0);
+#pragma omp parallel for schedule(dynamic, 16)
+	for (int r = 0; r < h; r++)
+		for (int i = row_offsets[r]; i < row_offsets[r + 1]; i++)
+			fill(labels.begin() + (size_t)r * w + runs[i].col_begin, labels.begin() + (size_t)r * w + runs[i].col_end, run_label[i]);
+
+	return region_cnt;
+}
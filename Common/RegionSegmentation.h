@@ -0,0 +1,265 @@
+#pragma once
+
+#include <vector>
+#include <set>
+#include <map>
+#include <array>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <opencv2/opencv.hpp>
+#include "RegionLabeling.h"
+#include "NoiseAbsorption.h"
+#include "BoundaryScan.h"
+#include "XjunctionScan.h"
+#include "RegionStore.h"
+
+using namespace std;
+
+//squared distance of two 8-bit BGR pixels
+inline int BgrDist2(const uchar* p, const uchar* q) {
+	int d0 = p[0] - q[0], d1 = p[1] - q[1], d2 = p[2] - q[2];
+	return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+//Preprocessing of a segmentation image (seg.png + mask.png) into regions, shared by ProcessRegionSegImg,
+//which writes the result to files, and ImageVectorization, which can hand it over in memory.
+class RegionSegmentation {
+public:
+	int h = 0, w = 0;
+	vector<int>				labels;				//region id of each pixel, 0: background
+	vector<vector<int>>		pids;				//sorted pixel ids of each region
+	vector<array<int, 3>>	colors;				//R, G, B of each region in region.png, random
+	vector<array<int, 4>>	bboxes;				//min_r, min_c, max_r, max_c
+	vector<set<int>>		adj_regions;		//adjacent regions, without the canvas 0
+	vector<int>				outmost_regions;	//regions on the image rectangle boundary, which may be the bottom layers
+	vector<array<int, 4>>	xjunctions;
+	LabelBoundaryInfo		boundary;
+
+public:
+	int RegionCnt() const {
+		return (int)pids.size();
+	}
+
+	//img, seg and mask are 8-bit BGR images as read by imread; the debug colors are drawn from color_seed,
+	//so they do not depend on what else draws random numbers in the process
+	void Segment(const cv::Mat& img, const cv::Mat& seg, const cv::Mat& mask, unsigned color_seed = 600) {
+		cv::Mat ori_img = img.isContinuous() ? img : img.clone();
+		cv::Mat reg_img = seg.isContinuous() ? seg : seg.clone();
+		cv::Mat mask_img = mask.isContinuous() ? mask : mask.clone();
+		h = reg_img.rows, w = reg_img.cols;
+
+		GetAllRegions(ori_img.data, reg_img.data, mask_img.data, color_seed);
+		GetAdjacencyInfo();
+		xjunctions = ScanXjunctions(labels.data(), h, w, 7);
+	}
+
+	//the regions in the binary form of region.bin, false if the label map does not fit in 16 bits
+	bool ToStore(RegionStore& store) const {
+		int region_cnt = RegionCnt();
+		if (region_cnt > 65535) {
+			cout << "too many regions for region.bin: " << region_cnt << endl;
+			return false;
+		}
+
+		store = RegionStore();
+		store.h = h, store.w = w;
+		store.label_map.assign(labels.begin(), labels.end());
+		store.bboxes.resize(region_cnt * 4, 0);
+		store.colors.resize(region_cnt * 3, 0);
+		store.perimeters.resize(region_cnt, 0);
+
+		//1. region color, bounding box and pixel runs=================================================
+		store.run_offsets.push_back(0);
+		store.run_offsets.push_back(0);
+		for (int i = 1; i < region_cnt; i++) {
+			for (int k = 0; k < 4; k++) store.bboxes[4 * i + k] = bboxes[i][k];
+			for (int k = 0; k < 3; k++) store.colors[3 * i + k] = colors[i][k];
+
+			int last_pid = -2;
+			for (int pid : pids[i]) {
+				if (pid == last_pid + 1 && pid % w != 0)
+					store.runs.back().col_end++;
+				else
+					store.runs.push_back({ pid / w, pid % w, pid % w + 1 });
+				last_pid = pid;
+			}
+			store.run_offsets.push_back(store.runs.size());
+		}
+
+		//2. adjacent regions and shared boundary pixcnt (outside of the image counts as region 0)======
+		store.adj_offsets.push_back(0);
+		store.adj_offsets.push_back(0);
+		store.boundary_offsets.push_back(0);
+		store.boundary_offsets.push_back(0);
+		for (int i = 1; i < region_cnt; i++) {
+			store.adj_rids.insert(store.adj_rids.end(), adj_regions[i].begin(), adj_regions[i].end());
+			store.adj_offsets.push_back(store.adj_rids.size());
+
+			store.perimeters[i] = boundary.perimeter[i];
+			boundary.ForEachNeighborOf(i, [&](int nb_rid, int pixcnt) {
+				store.boundaries.push_back({ nb_rid, pixcnt });
+			});
+			store.boundary_offsets.push_back(store.boundaries.size());
+		}
+
+		//3. possible bottom regions and x-junctions===================================================
+		store.bottom_rids.assign(outmost_regions.begin(), outmost_regions.end());
+		for (const array<int, 4>& xj : xjunctions)
+			store.xjunctions.insert(store.xjunctions.end(), xj.begin(), xj.end());
+		return true;
+	}
+
+	//region image (region.png) and region color index (region_index.png)
+	void WriteRegionImages(string reg_path, string region_ind_path) const {
+		cv::Mat regions(h, w, CV_8UC3, cv::Scalar(255, 255, 255));
+		for (int i = 1; i < RegionCnt(); i++) {
+			for (int pid : pids[i]) {
+				cv::Vec3b& pix = regions.at<cv::Vec3b>(pid / w, pid % w);
+				pix[2] = colors[i][0];
+				pix[1] = colors[i][1];
+				pix[0] = colors[i][2];
+			}
+		}
+		cv::imwrite(reg_path, regions);
+
+		int reg_cnt = RegionCnt() - 1;
+		int grid_len = 100;
+		int W = 8;
+		int H = (reg_cnt + 7) / 8;
+		cv::Mat region_ind(max(H, 1) * grid_len, W * grid_len, CV_8UC3, cv::Scalar(255, 255, 255));
+		for (int k = 1; k <= reg_cnt; k++) {
+			int i = (k - 1) / W, j = (k - 1) % W;
+			cv::Rect grid(j * grid_len, i * grid_len, grid_len, grid_len);
+			region_ind(grid).setTo(cv::Scalar(colors[k][2], colors[k][1], colors[k][0]));
+
+			int center_x = (i + 0.5) * grid_len;
+			int center_y = (j + 0.5) * grid_len;
+			cv::putText(region_ind, to_string(k), cv::Point(center_y - 9, center_x + 9), cv::FONT_HERSHEY_COMPLEX, 1, cv::Scalar(0, 0, 0));
+		}
+		cv::imwrite(region_ind_path, region_ind);
+	}
+
+	//region colors and bounding boxes, outermost regions, adjacent regions and x-junctions (region_info.txt)
+	void WriteRegionInfo(string reg_info_path) const {
+		ofstream of(reg_info_path);
+		of << RegionCnt() - 1 << endl;
+		for (int i = 1; i < RegionCnt(); i++) {
+			of << colors[i][0] << " " << colors[i][1] << " " << colors[i][2] << endl;
+			of << bboxes[i][0] << " " << bboxes[i][1] << " " << bboxes[i][2] << " " << bboxes[i][3] << endl;
+			of << endl;
+		}
+		of << endl;
+
+		of << outmost_regions.size() << endl;
+		for (int i = 0; i < outmost_regions.size(); i++)
+			of << outmost_regions[i] << " ";
+		of << endl << endl;
+
+		of << RegionCnt() - 1 << endl;
+		for (int i = 1; i < RegionCnt(); i++) {
+			of << i << " " << adj_regions[i].size() << endl;
+			for (int j : adj_regions[i])
+				of << j << "  ";
+			of << endl;
+		}
+
+		//x-junction detection may not correct, if so, it can be specified by user
+		of << endl << xjunctions.size() << endl;
+		for (const array<int, 4>& xj : xjunctions)
+			of << xj[0] << " " << xj[1] << " " << xj[2] << " " << xj[3] << endl;
+	}
+
+private:
+	void GetAllRegions(const uchar* ori, const uchar* reg, const uchar* mask, unsigned color_seed) {
+		//1. label 8-connected foreground pixels of similar color, region 0 is virtual, so number from 1
+		const double max_dist2 = (0.05 * 255) * (0.05 * 255);
+		int reg_cnt = LabelConnectedRegions(h, w,
+			[&](int pid) { return (mask[3 * pid] | mask[3 * pid + 1] | mask[3 * pid + 2]) != 0; },
+			[&](int pid1, int pid2) { return BgrDist2(reg + 3 * pid1, reg + 3 * pid2) < max_dist2; },
+			labels);
+
+		vector<int> pix_cnts(reg_cnt + 1, 0);
+		for (int i = 0; i < h * w; i++)
+			pix_cnts[labels[i]]++;
+
+		//2. assign each region a color, for debug
+		vector<array<int, 3>> reg_colors(reg_cnt + 1, array<int, 3>{ 0, 0, 0 });
+		mt19937 rng(color_seed);
+		for (int i = 1; i <= reg_cnt; i++) {
+			int R = rng() % 256, G = rng() % 256, B = rng() % 256;
+			reg_colors[i] = { R, G, B };
+		}
+
+		//3. process small noise regions: merge them into the neighbor of the closest color, then compact the ids
+		int noise_size = 20;
+		vector<int> new_rids = AbsorbNoiseRegions(labels, h, w, reg_cnt + 1, noise_size,
+			[&](int pid1, int pid2) { return BgrDist2(ori + 3 * pid1, ori + 3 * pid2); });
+
+		int region_cnt = *max_element(new_rids.begin(), new_rids.end()) + 1;
+		colors.assign(region_cnt, array<int, 3>{ 0, 0, 0 });
+		for (int i = 1; i <= reg_cnt; i++)
+			if (pix_cnts[i] > noise_size)
+				colors[new_rids[i]] = reg_colors[i];
+
+		//4. pixels are visited in raster order, so each region's pid list comes out sorted
+		pids.assign(region_cnt, vector<int>());
+		fill(pix_cnts.begin(), pix_cnts.end(), 0);
+		for (int i = 0; i < h * w; i++)
+			pix_cnts[labels[i]]++;
+		for (int i = 1; i < region_cnt; i++)
+			pids[i].reserve(pix_cnts[i]);
+		for (int i = 0; i < h * w; i++)
+			if (labels[i] != 0)
+				pids[labels[i]].push_back(i);
+
+		bboxes.assign(region_cnt, array<int, 4>{ 0, 0, 0, 0 });
+		for (int i = 1; i < region_cnt; i++) {
+			int min_r = h + 1, min_c = w + 1, max_r = -1, max_c = -1;
+			for (int pid : pids[i]) {
+				int r = pid / w, c = pid % w;
+				min_r = min(min_r, r), min_c = min(min_c, c);
+				max_r = max(max_r, r), max_c = max(max_c, c);
+			}
+			bboxes[i] = { min_r, min_c, max_r, max_c };
+		}
+	}
+
+	void GetAdjacencyInfo() {
+		int region_cnt = RegionCnt();
+		adj_regions.assign(region_cnt, set<int>());
+		boundary = ScanLabelBoundaries(labels.data(), h, w, region_cnt);
+
+		//0: background pixels, only counted from the region's side
+		map<pair<int, int>, int> region_boundary_pixcnt;
+		for (const LabelPairBoundary& p : boundary.pairs) {
+			if (p.rid == 0) continue;
+			adj_regions[p.rid].insert(p.nb_rid);
+			if (p.nb_rid != 0) adj_regions[p.nb_rid].insert(p.rid);
+			region_boundary_pixcnt[make_pair(min(p.rid, p.nb_rid), max(p.rid, p.nb_rid))] += p.pix_cnt;
+		}
+
+		//the regions on the image rectangle boundary are connected to 0
+		for (int rid = 1; rid < region_cnt; rid++)
+			if (boundary.TouchesImageBorder(rid))
+				adj_regions[rid].insert(0);
+
+		//some region pair have only share few pixels, they are not really neighbors.
+		for (auto it = region_boundary_pixcnt.begin(); it != region_boundary_pixcnt.end(); it++) {
+			if (it->second >= 5) continue;
+			int rid1 = it->first.first;
+			int rid2 = it->first.second;
+			adj_regions[rid1].erase(rid2);
+			adj_regions[rid2].erase(rid1);
+		}
+
+		//out most region should be connect to 0, they may be the bottom layers
+		outmost_regions.clear();
+		for (int i = 1; i < region_cnt; i++) {
+			if (adj_regions[i].erase(0))
+				outmost_regions.push_back(i);
+		}
+		adj_regions[0].clear();
+	}
+};
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+
+#include "MappedFile.h"
+
+using namespace std;
+
+//Binary region file (region.bin) written by ProcessRegionSegImg and mapped by ImageVectorization.
+//Every section is 4-byte aligned, per-region arrays are indexed by region id (0 is the canvas):
+//
+//	header | label map (uint16, h*w) | bboxes (4 per region) | colors (3 per region) | perimeters
+//	       | run offsets (region_cnt+1) | runs | adjacency offsets (region_cnt+1) | adjacent rids
+//	       | boundary offsets (region_cnt+1) | boundaries | bottom rids | x-junctions (4 per x-junction)
+
+#define REGION_STORE_MAGIC		0x4E474552	//"REGN"
+#define REGION_STORE_VERSION	1
+
+struct RegionStoreHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t  h, w;
+	int32_t  region_cnt;		//including the canvas region 0
+	int32_t  run_cnt;
+	int32_t  adj_cnt;
+	int32_t  boundary_cnt;
+	int32_t  bottom_cnt;
+	int32_t  xjunction_cnt;
+};
+
+//horizontal pixel run [col_begin, col_end) of a region in one row
+struct RegionRun {
+	int32_t row, col_begin, col_end;
+};
+
+//number of 8-neighbors of a region's pixels that belong to region nb_rid (0: canvas or outside the image)
+struct RegionBoundary {
+	int32_t nb_rid, pixcnt;
+};
+
+//read-only view of a region store, points either into a mapped region.bin or into a RegionStore
+struct RegionStoreView {
+	int h = 0, w = 0, region_cnt = 0;
+	int bottom_cnt = 0, xjunction_cnt = 0;
+	const uint16_t*			label_map = nullptr;
+	const int32_t*			bboxes = nullptr;
+	const int32_t*			colors = nullptr;
+	const int32_t*			perimeters = nullptr;
+	const int32_t*			run_offsets = nullptr;
+	const RegionRun*		runs = nullptr;
+	const int32_t*			adj_offsets = nullptr;
+	const int32_t*			adj_rids = nullptr;
+	const int32_t*			boundary_offsets = nullptr;
+	const RegionBoundary*	boundaries = nullptr;
+	const int32_t*			bottom_rids = nullptr;
+	const int32_t*			xjunctions = nullptr;
+};
+
+inline size_t RegionStoreAlign(size_t bytes) {
+	return (bytes + 3) & ~(size_t)3;
+}
+
+//lay the sections of a store with the given header out one after another, return the total file size
+inline size_t RegionStoreLayout(const RegionStoreHeader& hd, size_t offsets[12]) {
+	size_t n = hd.region_cnt;
+	size_t sizes[12] = {
+		(size_t)hd.h * hd.w * sizeof(uint16_t),
+		n * 4 * sizeof(int32_t),
+		n * 3 * sizeof(int32_t),
+		n * sizeof(int32_t),
+		(n + 1) * sizeof(int32_t),
+		(size_t)hd.run_cnt * sizeof(RegionRun),
+		(n + 1) * sizeof(int32_t),
+		(size_t)hd.adj_cnt * sizeof(int32_t),
+		(n + 1) * sizeof(int32_t),
+		(size_t)hd.boundary_cnt * sizeof(RegionBoundary),
+		(size_t)hd.bottom_cnt * sizeof(int32_t),
+		(size_t)hd.xjunction_cnt * 4 * sizeof(int32_t)
+	};
+	size_t pos = RegionStoreAlign(sizeof(RegionStoreHeader));
+	for (int i = 0; i < 12; i++) {
+		offsets[i] = pos;
+		pos += RegionStoreAlign(sizes[i]);
+	}
+	return pos;
+}
+
+//owning store, filled by the preprocessing step
+struct RegionStore {
+	int h = 0, w = 0;
+	vector<uint16_t>		label_map;
+	vector<int32_t>			bboxes;				//min_r, min_c, max_r, max_c
+	vector<int32_t>			colors;				//R, G, B of the region in region.png
+	vector<int32_t>			perimeters;
+	vector<int32_t>			run_offsets;
+	vector<RegionRun>		runs;
+	vector<int32_t>			adj_offsets;
+	vector<int32_t>			adj_rids;
+	vector<int32_t>			boundary_offsets;
+	vector<RegionBoundary>	boundaries;
+	vector<int32_t>			bottom_rids;
+	vector<int32_t>			xjunctions;
+
+	int RegionCnt() const {
+		return (int)perimeters.size();
+	}
+
+	RegionStoreHeader Header() const {
+		RegionStoreHeader hd;
+		hd.magic = REGION_STORE_MAGIC;
+		hd.version = REGION_STORE_VERSION;
+		hd.h = h, hd.w = w;
+		hd.region_cnt = RegionCnt();
+		hd.run_cnt = (int32_t)runs.size();
+		hd.adj_cnt = (int32_t)adj_rids.size();
+		hd.boundary_cnt = (int32_t)boundaries.size();
+		hd.bottom_cnt = (int32_t)bottom_rids.size();
+		hd.xjunction_cnt = (int32_t)xjunctions.size() / 4;
+		return hd;
+	}
+
+	RegionStoreView View() const {
+		RegionStoreView v;
+		v.h = h, v.w = w, v.region_cnt = RegionCnt();
+		v.bottom_cnt = (int)bottom_rids.size();
+		v.xjunction_cnt = (int)xjunctions.size() / 4;
+		v.label_map = label_map.data();
+		v.bboxes = bboxes.data();
+		v.colors = colors.data();
+		v.perimeters = perimeters.data();
+		v.run_offsets = run_offsets.data();
+		v.runs = runs.data();
+		v.adj_offsets = adj_offsets.data();
+		v.adj_rids = adj_rids.data();
+		v.boundary_offsets = boundary_offsets.data();
+		v.boundaries = boundaries.data();
+		v.bottom_rids = bottom_rids.data();
+		v.xjunctions = xjunctions.data();
+		return v;
+	}
+
+	bool Write(string path) const {
+		RegionStoreHeader hd = Header();
+		size_t offsets[12];
+		size_t file_size = RegionStoreLayout(hd, offsets);
+
+		const void* sections[12] = {
+			label_map.data(), bboxes.data(), colors.data(), perimeters.data(), run_offsets.data(), runs.data(),
+			adj_offsets.data(), adj_rids.data(), boundary_offsets.data(), boundaries.data(), bottom_rids.data(), xjunctions.data()
+		};
+		size_t sizes[12] = {
+			label_map.size() * sizeof(uint16_t), bboxes.size() * sizeof(int32_t), colors.size() * sizeof(int32_t),
+			perimeters.size() * sizeof(int32_t), run_offsets.size() * sizeof(int32_t), runs.size() * sizeof(RegionRun),
+			adj_offsets.size() * sizeof(int32_t), adj_rids.size() * sizeof(int32_t), boundary_offsets.size() * sizeof(int32_t),
+			boundaries.size() * sizeof(RegionBoundary), bottom_rids.size() * sizeof(int32_t), xjunctions.size() * sizeof(int32_t)
+		};
+
+		vector<char> buf(file_size, 0);
+		memcpy(buf.data(), &hd, sizeof(hd));
+		for (int i = 0; i < 12; i++)
+			if (sizes[i] > 0) memcpy(buf.data() + offsets[i], sections[i], sizes[i]);
+
+		ofstream of(path, ios::binary);
+		if (!of) return false;
+		of.write(buf.data(), buf.size());
+		return (bool)of;
+	}
+};
+
+//===================================================================================
+
+//maps region.bin read-only, the view stays valid as long as this object lives
+class MappedRegionStore {
+private:
+	MappedFile m_file;
+
+public:
+	RegionStoreView view;
+
+public:
+	MappedRegionStore() {}
+	MappedRegionStore(const MappedRegionStore&) = delete;
+	MappedRegionStore& operator=(const MappedRegionStore&) = delete;
+
+	bool Open(string path) {
+		Close();
+		if (!m_file.Open(path)) return false;
+		const char* data = m_file.Data();
+
+		RegionStoreHeader hd;
+		if (m_file.Size() < sizeof(hd)) { Close(); return false; }
+		memcpy(&hd, data, sizeof(hd));
+		if (hd.magic != REGION_STORE_MAGIC || hd.version != REGION_STORE_VERSION) {
+			cout << "invalid region store: " << path << endl;
+			Close();
+			return false;
+		}
+
+		size_t offsets[12];
+		bool counts_ok = hd.h > 0 && hd.w > 0 && hd.region_cnt > 0 && hd.run_cnt >= 0 && hd.adj_cnt >= 0
+			&& hd.boundary_cnt >= 0 && hd.bottom_cnt >= 0 && hd.xjunction_cnt >= 0;
+		if (!counts_ok || RegionStoreLayout(hd, offsets) > m_file.Size()) {
+			cout << "truncated region store: " << path << endl;
+			Close();
+			return false;
+		}
+
+		view.h = hd.h, view.w = hd.w, view.region_cnt = hd.region_cnt;
+		view.bottom_cnt = hd.bottom_cnt, view.xjunction_cnt = hd.xjunction_cnt;
+		view.label_map = (const uint16_t*)(data + offsets[0]);
+		view.bboxes = (const int32_t*)(data + offsets[1]);
+		view.colors = (const int32_t*)(data + offsets[2]);
+		view.perimeters = (const int32_t*)(data + offsets[3]);
+		view.run_offsets = (const int32_t*)(data + offsets[4]);
+		view.runs = (const RegionRun*)(data + offsets[5]);
+		view.adj_offsets = (const int32_t*)(data + offsets[6]);
+		view.adj_rids = (const int32_t*)(data + offsets[7]);
+		view.boundary_offsets = (const int32_t*)(data + offsets[8]);
+		view.boundaries = (const RegionBoundary*)(data + offsets[9]);
+		view.bottom_rids = (const int32_t*)(data + offsets[10]);
+		view.xjunctions = (const int32_t*)(data + offsets[11]);
+		if (!IsConsistent(hd, view)) {
+			cout << "corrupted region store: " << path << endl;
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close() {
+		m_file.Close();
+		view = RegionStoreView();
+	}
+
+private:
+	//checked once when mapped, so that reading the store never goes out of bounds: the offsets increase and
+	//end at the counts, every run lies in the label map and every label and id is a region id
+	static bool IsConsistent(const RegionStoreHeader& hd, const RegionStoreView& v) {
+		int n = hd.region_cnt;
+		auto offsets_ok = [&](const int32_t* offsets, int32_t cnt) {
+			if (offsets[0] != 0 || offsets[n] != cnt) return false;
+			for (int i = 0; i < n; i++)
+				if (offsets[i] > offsets[i + 1]) return false;
+			return true;
+		};
+		auto rid_ok = [&](int32_t rid) { return rid >= 0 && rid < n; };
+
+		if (!offsets_ok(v.run_offsets, hd.run_cnt) || !offsets_ok(v.adj_offsets, hd.adj_cnt) || !offsets_ok(v.boundary_offsets, hd.boundary_cnt))
+			return false;
+		for (int i = 0; i < hd.run_cnt; i++) {
+			const RegionRun& run = v.runs[i];
+			if (run.row < 0 || run.row >= hd.h || run.col_begin < 0 || run.col_begin > run.col_end || run.col_end > hd.w) return false;
+		}
+		for (int i = 0; i < hd.adj_cnt; i++)
+			if (!rid_ok(v.adj_rids[i])) return false;
+		for (int i = 0; i < hd.boundary_cnt; i++)
+			if (!rid_ok(v.boundaries[i].nb_rid)) return false;
+		for (int i = 0; i < hd.bottom_cnt; i++)
+			if (!rid_ok(v.bottom_rids[i])) return false;
+		for (int i = 0; i < 4 * hd.xjunction_cnt; i++)
+			if (!rid_ok(v.xjunctions[i])) return false;
+		for (size_t i = 0; i < (size_t)hd.h * hd.w; i++)
+			if (v.label_map[i] >= n) return false;
+		return true;
+	}
+};
+
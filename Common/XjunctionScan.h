@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+//offsets of the outermost ring of an s*s square, walked down the left side, along the bottom, up the right side and back along the top
+inline void GenerateSquareRingOffsets(int s, vector<int>& dr, vector<int>& dc) {
+	dr.clear(); dc.clear();
+	for (int i = 0; i < s; i++)
+		dr.push_back(-s / 2 + i), dc.push_back(-s / 2);
+	for (int i = 0; i < s - 2; i++)
+		dr.push_back(s / 2), dc.push_back(-s / 2 + 1 + i);
+	for (int i = s - 1; i >= 0; i--)
+		dr.push_back(-s / 2 + i), dc.push_back(s / 2);
+	for (int i = s - 2; i > 0; i--)
+		dr.push_back(-s / 2), dc.push_back(-s / 2 + i);
+}
+
+//x-junctions are identified by their set of 4 labels, whatever the ring order
+struct XjunctionKeyHash {
+	size_t operator()(const array<int, 4>& k) const {
+		uint64_t x = 0;
+		for (int v : k) x = (x ^ (uint32_t)v) * 0x100000001B3ull;
+		return (size_t)(x ^ (x >> 29));
+	}
+};
+
+inline array<int, 4> XjunctionKey(const array<int, 4>& xj) {
+	array<int, 4> k = xj;
+	sort(k.begin(), k.end());
+	return k;
+}
+
+//Find points where exactly 4 labels meet. Every boundary pixel (a pixel of a label other than 0 with an
+//8-neighbor of another label) is probed with the ring of a ring_size*ring_size square around it; a ring
+//seeing 4 labels gives an x-junction, labels kept in ring order. A junction can lie a few pixels away from
+//any point where 3 labels touch, so all boundary pixels are probed, not only those. Bands of rows run in
+//parallel and are merged in raster order.
+template<typename Label>
+vector<array<int, 4>> ScanXjunctions(const Label* labels, int h, int w, int ring_size = 7) {
+	vector<int> dr, dc;
+	GenerateSquareRingOffsets(ring_size, dr, dc);
+
+	int band_cnt = 1;
+#ifdef _OPENMP
+	band_cnt = max(1, min(omp_get_max_threads(), h / 16));
+#endif
+	vector<vector<array<int, 4>>> band_xjs(band_cnt);
+
+#pragma omp parallel for schedule(static, 1)
+	for (int b = 0; b < band_cnt; b++) {
+		unordered_set<array<int, 4>, XjunctionKeyHash> found;
+		int row_begin = (int)((int64_t)h * b / band_cnt);
+		int row_end = (int)((int64_t)h * (b + 1) / band_cnt);
+
+		for (int r = row_begin; r < row_end; r++) {
+			for (int c = 0; c < w; c++) {
+				Label label = labels[(size_t)r * w + c];
+				if (label == 0) continue;
+				bool boundary = false;
+				for (int nr = max(0, r - 1); nr <= min(h - 1, r + 1) && !boundary; nr++)
+					for (int nc = max(0, c - 1); nc <= min(w - 1, c + 1) && !boundary; nc++)
+						boundary = labels[(size_t)nr * w + nc] != label;
+				if (!boundary) continue;
+
+				int rids[4], rid_n = 0;
+				bool too_many = false;
+				for (int j = 0; j < dr.size() && !too_many; j++) {
+					int new_r = r + dr[j], new_c = c + dc[j];
+					if (new_r < 0 || new_r >= h || new_c < 0 || new_c >= w) continue;
+					int rid = labels[(size_t)new_r * w + new_c];
+					if (find(rids, rids + rid_n, rid) != rids + rid_n) continue;
+					if (rid_n == 4) too_many = true;
+					else rids[rid_n++] = rid;
+				}
+				if (too_many || rid_n != 4) continue;
+
+				array<int, 4> xj = { rids[0], rids[1], rids[2], rids[3] };
+				if (found.insert(XjunctionKey(xj)).second)
+					band_xjs[b].push_back(xj);
+			}
+		}
+	}
+
+	vector<array<int, 4>> xjs;
+	unordered_set<array<int, 4>, XjunctionKeyHash> found;
+	for (int b = 0; b < band_cnt; b++)
+		for (const array<int, 4>& xj : band_xjs[b])
+			if (found.insert(XjunctionKey(xj)).second)
+				xjs.push_back(xj);
+	return xjs;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include "ThreadPool.h"
+#include "Pipeline.h"
+
+using namespace std;
+
+//Decomposes many cases on one work-stealing pool. Every case is split into stage tasks, the layer merging,
+//optimization and output of its configurations are fanned out, so small cases fill the gaps left by large ones.
+class BatchRunner {
+private:
+	struct JobState {
+		DecompositionJob				job;
+		chrono::steady_clock::time_point	start, end;
+		int								config_cnt = 0;
+		bool							ok = false;
+
+		JobState(string data_dir, const VectorizationConfig& config) : job(data_dir, config) {
+			job.m_in_pool = true;
+		}
+	};
+
+	VectorizationConfig			m_config;
+	ThreadPool					m_pool;
+	vector<unique_ptr<JobState>> m_states;
+	mutex						m_report_mutex;
+
+public:
+	BatchRunner(const VectorizationConfig& config) : m_config(config), m_pool(config.thread_cnt) {}
+
+	//one data directory per line, empty lines and lines starting with '#' are skipped
+	static vector<string> ReadManifest(string manifest_path) {
+		vector<string> data_dirs;
+		ifstream ifs(manifest_path);
+		string line;
+		while (getline(ifs, line)) {
+			while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+				line.pop_back();
+			size_t k = line.find_first_not_of(" \t");
+			if (k == string::npos || line[k] == '#') continue;
+			data_dirs.push_back(line.substr(k));
+		}
+		return data_dirs;
+	}
+
+	//returns the cnt of cases that were decomposed
+	int Run(const vector<string>& data_dirs) {
+		auto t0 = chrono::steady_clock::now();
+		m_states.clear();
+		for (const string& dir : data_dirs)
+			m_states.push_back(make_unique<JobState>(dir, m_config));
+		for (auto& s : m_states)
+			Schedule(s.get());
+		m_pool.WaitAll();
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+		if (m_config.deterministic) {
+			for (auto& s : m_states)
+				s->job.ReportMetrics(s->ok, chrono::duration<double>(s->end - s->start).count(), s->job.m_metrics.TotalCpu());
+		}
+
+		int ok_cnt = 0;
+		cout << "\n\nbatch report: " << m_states.size() << " cases, " << m_pool.ThreadCnt() << " threads" << endl;
+		for (auto& s : m_states) {
+			double t = chrono::duration<double>(s->end - s->start).count();
+			cout << (s->ok ? "  ok     " : "  failed ") << setw(8) << fixed << setprecision(2) << t << " s  "
+				<< setw(4) << s->config_cnt << " configs  " << s->job.m_name << endl;
+			ok_cnt += s->ok;
+		}
+		cout << "total " << fixed << setprecision(2) << wall << " s, " << ok_cnt << " decomposed, "
+			<< (wall > 0 ? ok_cnt * 60.0 / wall : 0.0) << " images/min" << endl;
+		return ok_cnt;
+	}
+
+private:
+	void Schedule(JobState* s) {
+		m_pool.Submit([this, s] {
+			s->start = chrono::steady_clock::now();
+			DecompositionJob& job = s->job;
+			if (!job.LoadInput()) {
+				Finish(s, false);
+				return;
+			}
+			if (job.UseHierarchicalMode()) {
+				int group_cnt = job.GroupRegions();
+				m_pool.ParallelFor(group_cnt, [s](int g) { s->job.SolveRegionGroup(g); }, [this, s] {
+					if (!s->job.JoinRegionGroups()) {
+						Finish(s, false);
+						return;
+					}
+					ScheduleConfigurations(s);
+				});
+				return;
+			}
+			if (!job.BuildRegionSupportingTrees()) {
+				Finish(s, false);
+				return;
+			}
+			ScheduleConfigurations(s);
+		});
+	}
+
+	//layer merging, optimization and output of the trees of a case
+	void ScheduleConfigurations(JobState* s) {
+		m_pool.ParallelFor(s->job.m_lms.size(), [s](int ind) { s->job.MergeLayers(ind); }, [this, s] {
+			s->config_cnt = s->job.DeduplicateLayerConfigurations();
+			m_pool.ParallelFor(s->config_cnt, [s](int ind) { s->job.VectorizeLayers(ind); }, [this, s] {
+				int output_cnt = s->job.SortResults();
+				m_pool.ParallelFor(output_cnt, [s](int ind) { s->job.OutputResult(ind); }, [this, s] {
+					s->job.FinishOutput();
+					Finish(s, true);
+				});
+			});
+		});
+	}
+
+	//the case is reported as it finishes, or in manifest order at the end in deterministic mode
+	void Finish(JobState* s, bool ok) {
+		s->end = chrono::steady_clock::now();
+		s->ok = ok;
+		s->job.Release();
+		if (m_config.deterministic) return;
+		lock_guard<mutex> lock(m_report_mutex);
+		s->job.ReportMetrics(ok, chrono::duration<double>(s->end - s->start).count(), s->job.m_metrics.TotalCpu());
+	}
+};
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include "Config.h"
+#include "Pipeline.h"
+#include "Instrumentation.h"
+
+using namespace std;
+
+struct BenchmarkOptions {
+	int		repeat_cnt = 3;				//end-to-end runs per case
+	string	baseline_out;				//write the summary as a baseline file when set
+	string	baseline_in;				//compare against this baseline file when set
+	double	speed_tolerance = 0.15;		//a stage median may be this much slower (relative) than the baseline
+	double	min_time_delta = 0.05;		//slowdowns below this many seconds are timer noise
+	double	loss_tolerance = 0.01;		//a configuration loss may be this much higher (relative) than the baseline
+	vector<string>	presets;			//run the cases once per preset and print a table of them instead
+};
+
+//the 10 cases shipped in Data/
+inline vector<string> DefaultBenchmarkCases(string data_root = "../Data") {
+	vector<string> names = { "1-Syn1", "2-Syn2", "3-Syn3", "4-Syn4", "5-syn5", "6-Can", "7-Battery", "8-Phone", "9-Egg", "10-Cone" };
+	vector<string> dirs;
+	for (const string& name : names)
+		dirs.push_back(data_root + "/" + name);
+	return dirs;
+}
+
+//Runs every case several times end-to-end and keeps the median/p95 of each stage, the peak memory,
+//the optimizer evaluation counts and the loss of each configuration. The summary is written as a
+//baseline file, a later run compares itself against it and reports speed and quality regressions.
+//
+//baseline file: one tab separated record per line, '#' lines are comments
+//  stage	<case>	<stage>	<median wall>	<p95 wall>	<median cpu>	<p95 cpu>
+//  counter	<case>	<counter>	<median>
+//  memory	<case>	peak_bytes	<bytes>		(memory	process	peak_bytes	<bytes> where the mark can not be reset per case)
+//  config	<case>	<config id>	<median loss>	<median evals>
+//  quality	<case>	best_loss	<median best loss>	<config cnt>
+class BenchmarkSuite {
+private:
+	struct CaseSummary {
+		string							name;
+		int								ok_cnt = 0;
+		vector<string>					stage_order;
+		map<string, vector<double>>		stage_walls, stage_cpus;	//one entry per repeat
+		map<string, vector<double>>		counters;
+		map<int, vector<double>>		config_losses, config_evals;
+		vector<double>					best_losses;
+		int								config_cnt = 0;
+		long long						peak_mem = 0;
+	};
+
+	VectorizationConfig		m_config;
+	BenchmarkOptions		m_options;
+	vector<CaseSummary>		m_cases;
+	bool					m_peak_mem_per_case = true;		//the memory high-water mark is reset before every case
+
+public:
+	BenchmarkSuite(const VectorizationConfig& config, const BenchmarkOptions& options) : m_config(config), m_options(options) {}
+
+	//returns the cnt of regressions against the baseline, 0 when there is no baseline to compare with
+	int Run(const vector<string>& data_dirs) {
+		m_cases.clear();
+		for (const string& dir : data_dirs)
+			m_cases.push_back(RunCase(dir));
+
+		PrintSummary();
+		if (!m_options.baseline_out.empty())
+			WriteBaseline(m_options.baseline_out);
+		if (m_options.baseline_in.empty())
+			return 0;
+		return CompareWithBaseline(m_options.baseline_in);
+	}
+
+	//the cases once per preset, on top of the other options, then one markdown row per preset: the wall time
+	//summed over the cases and the best loss averaged over them, both from the medians of the repeats
+	void RunPresets(const vector<string>& data_dirs) {
+		VectorizationConfig config = m_config;
+		vector<string> rows;
+		for (const string& preset : m_options.presets) {
+			m_config = config;
+			if (!ApplyPreset(m_config, preset) || !CheckConfig(m_config)) continue;
+			m_cases.clear();
+			for (const string& dir : data_dirs)
+				m_cases.push_back(RunCase(dir));
+			PrintSummary();
+
+			double wall = 0, loss = 0;
+			int ok_cnt = 0;
+			for (const CaseSummary& cs : m_cases) {
+				if (cs.stage_walls.count("total")) wall += Median(cs.stage_walls.at("total"));
+				if (cs.best_losses.empty()) continue;
+				loss += Median(cs.best_losses);
+				ok_cnt++;
+			}
+			ostringstream os;
+			os << fixed << "| " << left << setw(8) << preset << right << " | " << setw(13) << setprecision(2) << wall
+				<< " | " << setw(14) << setprecision(4) << (ok_cnt ? loss / ok_cnt : 0.0) << " | " << ok_cnt << "/" << m_cases.size() << " |";
+			rows.push_back(os.str());
+		}
+		m_config = config;
+
+		cout << "\n\npresets, " << data_dirs.size() << " cases, " << m_options.repeat_cnt << " runs each\n\n"
+			"| preset   | wall time (s) | mean best loss | cases |\n"
+			"|----------|---------------|----------------|-------|" << endl;
+		for (const string& row : rows)
+			cout << row << endl;
+	}
+
+	//nearest rank percentile, p in [0, 1]
+	static double Percentile(vector<double> v, double p) {
+		if (v.empty()) return 0;
+		sort(v.begin(), v.end());
+		int k = (int)ceil(p * v.size()) - 1;
+		return v[max(0, min((int)v.size() - 1, k))];
+	}
+
+	static double Median(const vector<double>& v) {
+		if (v.empty()) return 0;
+		vector<double> s = v;
+		sort(s.begin(), s.end());
+		int n = s.size();
+		return n % 2 ? s[n / 2] : 0.5 * (s[n / 2 - 1] + s[n / 2]);
+	}
+
+private:
+	static string CaseName(string data_dir) {
+		while (!data_dir.empty() && (data_dir.back() == '/' || data_dir.back() == '\\'))
+			data_dir.pop_back();
+		size_t k = data_dir.find_last_of("/\\");
+		return k == string::npos ? data_dir : data_dir.substr(k + 1);
+	}
+
+	CaseSummary RunCase(string data_dir) {
+		CaseSummary cs;
+		cs.name = CaseName(data_dir);
+		m_peak_mem_per_case = ResetPeakMemory();
+		for (int r = 0; r < m_options.repeat_cnt; r++) {
+			cout << "\n\nbenchmark " << cs.name << " run " << r + 1 << "/" << m_options.repeat_cnt << "======================\n\n";
+			DecompositionJob Job(data_dir, m_config, cs.name);
+			bool ok = Job.Run();
+			cs.ok_cnt += ok;
+
+			for (const StageRecord& s : Job.m_metrics.Stages()) {
+				if (!cs.stage_walls.count(s.name)) cs.stage_order.push_back(s.name);
+				cs.stage_walls[s.name].push_back(s.wall);
+				cs.stage_cpus[s.name].push_back(s.cpu);
+			}
+			for (auto& kv : Job.m_metrics.Counters())
+				cs.counters[kv.first].push_back((double)kv.second);
+
+			vector<ConfigRecord> configs = Job.m_metrics.Configs();
+			long long eval_cnt = 0;
+			double best_loss = 1e8;
+			for (const ConfigRecord& c : configs) {
+				cs.config_losses[c.config_id].push_back(c.loss);
+				cs.config_evals[c.config_id].push_back(c.eval_cnt);
+				eval_cnt += c.eval_cnt;
+				best_loss = min(best_loss, c.loss);
+			}
+			cs.counters["evals"].push_back((double)eval_cnt);
+			if (ok) cs.best_losses.push_back(best_loss);
+			cs.config_cnt = configs.size();
+		}
+		//the high-water mark of the case's runs, or of the process so far where it can not be reset
+		cs.peak_mem = PeakMemoryBytes();
+		return cs;
+	}
+
+	void PrintSummary() {
+		cout << "\n\nbenchmark summary: " << m_cases.size() << " cases, " << m_options.repeat_cnt << " runs each" << endl;
+		cout << fixed;
+		for (const CaseSummary& cs : m_cases) {
+			cout << cs.name << ": " << cs.ok_cnt << "/" << m_options.repeat_cnt << " ok, " << cs.config_cnt << " configs, best loss "
+				<< setprecision(4) << Median(cs.best_losses) << ", " << setprecision(0) << Median(cs.counters.count("evals") ? cs.counters.at("evals") : vector<double>())
+				<< " evals, peak memory " << setprecision(1) << cs.peak_mem / 1048576.0 << " MB" << (m_peak_mem_per_case ? "" : " (process)") << endl;
+			for (const string& name : cs.stage_order) {
+				const vector<double>& walls = cs.stage_walls.at(name);
+				cout << "  " << left << setw(14) << name << right << setprecision(3)
+					<< " wall median " << setw(9) << Median(walls) << " s  p95 " << setw(9) << Percentile(walls, 0.95) << " s"
+					<< "   cpu median " << setw(9) << Median(cs.stage_cpus.at(name)) << " s" << endl;
+			}
+		}
+		cout.unsetf(ios::fixed);
+	}
+
+	void WriteBaseline(string path) {
+		ofstream of(path);
+		if (!of) {
+			cout << "can not write baseline file: " << path << endl;
+			return;
+		}
+		of << setprecision(9);
+		of << "# ImageVectorization benchmark baseline, " << m_options.repeat_cnt << " runs per case\n";
+		for (const CaseSummary& cs : m_cases) {
+			for (const string& name : cs.stage_order) {
+				const vector<double>& walls = cs.stage_walls.at(name);
+				const vector<double>& cpus = cs.stage_cpus.at(name);
+				of << "stage\t" << cs.name << "\t" << name << "\t" << Median(walls) << "\t" << Percentile(walls, 0.95)
+					<< "\t" << Median(cpus) << "\t" << Percentile(cpus, 0.95) << "\n";
+			}
+			for (auto& kv : cs.counters)
+				of << "counter\t" << cs.name << "\t" << kv.first << "\t" << Median(kv.second) << "\n";
+			if (m_peak_mem_per_case)
+				of << "memory\t" << cs.name << "\tpeak_bytes\t" << cs.peak_mem << "\n";
+			for (auto& kv : cs.config_losses)
+				of << "config\t" << cs.name << "\t" << kv.first << "\t" << Median(kv.second) << "\t" << Median(cs.config_evals.at(kv.first)) << "\n";
+			of << "quality\t" << cs.name << "\tbest_loss\t" << Median(cs.best_losses) << "\t" << cs.config_cnt << "\n";
+		}
+		if (!m_peak_mem_per_case)
+			of << "memory\tprocess\tpeak_bytes\t" << PeakMemoryBytes() << "\n";
+		cout << "baseline written to " << path << endl;
+	}
+
+	//"kind\tcase\tkey" -> values
+	static map<string, vector<double>> ReadBaseline(string path) {
+		map<string, vector<double>> records;
+		ifstream ifs(path);
+		string line;
+		while (getline(ifs, line)) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (line.empty() || line[0] == '#') continue;
+			vector<string> fields;
+			stringstream ss(line);
+			string field;
+			while (getline(ss, field, '\t'))
+				fields.push_back(field);
+			if (fields.size() < 4) continue;
+			vector<double> values;
+			for (int i = 3; i < fields.size(); i++)
+				values.push_back(atof(fields[i].c_str()));
+			records[fields[0] + "\t" + fields[1] + "\t" + fields[2]] = values;
+		}
+		return records;
+	}
+
+	int CompareWithBaseline(string path) {
+		map<string, vector<double>> base = ReadBaseline(path);
+		if (base.empty()) {
+			cout << "can not read baseline file: " << path << endl;
+			return 0;
+		}
+
+		int regression_cnt = 0;
+		cout << "\n\ncomparison with baseline " << path << endl;
+		cout << fixed;
+		for (const CaseSummary& cs : m_cases) {
+			//1. speed: the wall median of every stage====
+			for (const string& name : cs.stage_order) {
+				auto it = base.find("stage\t" + cs.name + "\t" + name);
+				if (it == base.end()) continue;
+				double b = it->second[0], c = Median(cs.stage_walls.at(name));
+				bool slower = c > b * (1 + m_options.speed_tolerance) && c - b > m_options.min_time_delta;
+				if (slower || name == "total")
+					cout << (slower ? "  SLOWER  " : "  ok      ") << cs.name << " " << name << ": " << setprecision(3)
+						<< b << " s -> " << c << " s (" << showpos << (b > 0 ? (c / b - 1) * 100 : 0.0) << noshowpos << "%)" << endl;
+				regression_cnt += slower;
+			}
+
+			//2. quality: the best loss and the loss of each configuration====
+			auto it = base.find("quality\t" + cs.name + "\tbest_loss");
+			if (it != base.end()) {
+				double b = it->second[0], c = Median(cs.best_losses);
+				int base_config_cnt = it->second.size() > 1 ? (int)it->second[1] : cs.config_cnt;
+				bool worse = c > b + m_options.loss_tolerance * fabs(b);
+				cout << (worse ? "  WORSE   " : "  ok      ") << cs.name << " best loss: " << setprecision(6) << b << " -> " << c << endl;
+				if (base_config_cnt != cs.config_cnt)
+					cout << "  note    " << cs.name << " config cnt: " << base_config_cnt << " -> " << cs.config_cnt << endl;
+				regression_cnt += worse;
+			}
+			for (auto& kv : cs.config_losses) {
+				auto cit = base.find("config\t" + cs.name + "\t" + to_string(kv.first));
+				if (cit == base.end()) continue;
+				double b = cit->second[0], c = Median(kv.second);
+				if (c > b + m_options.loss_tolerance * fabs(b)) {
+					cout << "  WORSE   " << cs.name << " config " << kv.first << " loss: " << setprecision(6) << b << " -> " << c << endl;
+					regression_cnt++;
+				}
+			}
+		}
+		cout.unsetf(ios::fixed);
+		cout << regression_cnt << " regression(s)" << endl;
+		return regression_cnt;
+	}
+};
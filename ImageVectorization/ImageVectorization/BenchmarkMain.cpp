@@ -0,0 +1,60 @@
+#include <opencv2/opencv.hpp>
+#include "Config.h"
+#include "Benchmark.h"
+#include <cstdlib>
+using namespace std;
+
+int main(int argc, char** argv) {
+
+	//Benchmark [benchmark options] [ImageVectorization options] [data_dir ...]
+	//without data directories all the cases in ../Data are run
+	VectorizationConfig cfg;
+	cfg.data_dirs = DefaultBenchmarkCases();
+	BenchmarkOptions opt;
+
+	vector<char*> args = { argv[0] };
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool is_bench_option = arg == "--repeat" || arg == "--baseline-out" || arg == "--compare"
+			|| arg == "--speed-tolerance" || arg == "--loss-tolerance" || arg == "--min-time-delta" || arg == "--presets";
+		if (!is_bench_option) {
+			args.push_back(argv[i]);
+			continue;
+		}
+		if (i + 1 >= argc) {
+			cout << "missing value for " << arg << endl;
+			return 1;
+		}
+		string value = argv[++i];
+		if (arg == "--repeat") opt.repeat_cnt = max(1, atoi(value.c_str()));
+		else if (arg == "--baseline-out") opt.baseline_out = value;
+		else if (arg == "--compare") opt.baseline_in = value;
+		else if (arg == "--speed-tolerance") opt.speed_tolerance = atof(value.c_str());
+		else if (arg == "--loss-tolerance") opt.loss_tolerance = atof(value.c_str());
+		else if (arg == "--min-time-delta") opt.min_time_delta = atof(value.c_str());
+		else if (arg == "--presets") {
+			stringstream ss(value);
+			string name;
+			while (getline(ss, name, ','))
+				if (!name.empty()) opt.presets.push_back(name);
+		}
+	}
+	if (!ParseCommandLine((int)args.size(), args.data(), cfg)) {
+		cout << "benchmark options:\n"
+			"  --repeat <n>                     end-to-end runs per case, default 3\n"
+			"  --baseline-out <file>            write medians, p95, peak memory, evals and losses\n"
+			"  --compare <file>                 report regressions against a baseline, exit code 2 if any\n"
+			"  --speed-tolerance <x>            allowed relative slowdown of a stage median, default 0.15\n"
+			"  --min-time-delta <s>             slowdowns below this are ignored, default 0.05\n"
+			"  --loss-tolerance <x>             allowed relative loss increase, default 0.01\n"
+			"  --presets <a,b,...>              run the cases once per preset, print wall time and best loss per preset" << endl;
+		return 1;
+	}
+
+	BenchmarkSuite Suite(cfg, opt);
+	if (!opt.presets.empty()) {
+		Suite.RunPresets(cfg.data_dirs);
+		return 0;
+	}
+	return Suite.Run(cfg.data_dirs) > 0 ? 2 : 0;
+}
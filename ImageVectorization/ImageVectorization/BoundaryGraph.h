@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "ContourFitting.h"
+
+using namespace std;
+using namespace cv;
+
+//Planar graph of the boundaries of a region label map, built once per case and shared by the outlines
+//of all objects: nodes are the pixel corners where three or more crack edges meet (three labels, or two
+//labels touching diagonally), chains are the crack edge runs between two nodes, or closed runs without
+//any node, that separate the same pair of labels. Every chain is fitted once, so the outlines of
+//neighboring objects share their curves exactly and leave no gaps between them.
+
+struct BoundaryChain {
+	int left = -1, right = -1;				//labels on either side walking from start to end, -1 outside the image
+	int start_node = -1, end_node = -1;		//corner index y * (w + 1) + x, -1 for closed chains
+	int start_dir = 0, end_dir = 0;			//direction of the first and the last crack edge
+	vector<Vec2i> corners;					//start, turns, end; a closed chain lists its turns only
+	vector<BezierSegment> curve;
+};
+
+class BoundaryGraph {
+public:
+	int h = 0, w = 0;
+	vector<BoundaryChain> chains;
+	vector<vector<int>> label_chains;		//chains bordering each label
+
+private:
+	const int* m_labels = nullptr;
+	vector<uint8_t> m_hvisited, m_vvisited;	//crack edges walked: (x, y)-(x + 1, y) and (x, y)-(x, y + 1)
+
+	int Label(int r, int c) const {
+		return r < 0 || c < 0 || r >= h || c >= w ? -1 : m_labels[(size_t)r * w + c];
+	}
+
+	//labels on the right and on the left of the crack edge leaving corner (x, y) in direction d
+	Vec2i Sides(int x, int y, int d) const {
+		switch (d) {
+		case 0: return Vec2i(Label(y, x), Label(y - 1, x));
+		case 1: return Vec2i(Label(y, x - 1), Label(y, x));
+		case 2: return Vec2i(Label(y - 1, x - 1), Label(y, x - 1));
+		default: return Vec2i(Label(y - 1, x), Label(y - 1, x - 1));
+		}
+	}
+
+	bool HasEdge(int x, int y, int d) const {
+		int nx = x + kCrackDx[d], ny = y + kCrackDy[d];
+		if (nx < 0 || ny < 0 || nx > w || ny > h) return false;
+		Vec2i s = Sides(x, y, d);
+		return s[0] != s[1];
+	}
+
+	uint8_t& Visited(int x, int y, int d) {
+		switch (d) {
+		case 0: return m_hvisited[(size_t)y * w + x];
+		case 1: return m_vvisited[(size_t)y * (w + 1) + x];
+		case 2: return m_hvisited[(size_t)y * w + x - 1];
+		default: return m_vvisited[(size_t)(y - 1) * (w + 1) + x];
+		}
+	}
+
+	int Degree(int x, int y) const {
+		int deg = 0;
+		for (int d = 0; d < 4; d++) deg += HasEdge(x, y, d);
+		return deg;
+	}
+
+	//walk from corner (x, y) in direction d until a node, or back to the start of a closed chain
+	void Walk(int x, int y, int d, bool from_node) {
+		BoundaryChain chain;
+		Vec2i sides = Sides(x, y, d);
+		chain.right = sides[0], chain.left = sides[1];
+		chain.start_dir = d;
+		chain.start_node = from_node ? y * (w + 1) + x : -1;
+		if (from_node) chain.corners.push_back(Vec2i(x, y));
+
+		int x0 = x, y0 = y;
+		while (true) {
+			Visited(x, y, d) = 1;
+			x += kCrackDx[d], y += kCrackDy[d];
+			if (from_node ? Degree(x, y) > 2 : (x == x0 && y == y0)) break;
+			int next = d;
+			for (int t : { 1, 0, 3 })
+				if (HasEdge(x, y, (d + t) % 4)) { next = (d + t) % 4; break; }
+			if (next != d) chain.corners.push_back(Vec2i(x, y));
+			d = next;
+		}
+		chain.end_dir = d;
+		if (from_node) {
+			chain.end_node = y * (w + 1) + x;
+			chain.corners.push_back(Vec2i(x, y));
+		}
+		else if (d != chain.start_dir)
+			chain.corners.push_back(Vec2i(x, y));
+		chains.push_back(chain);
+	}
+
+public:
+	//labels: h x w, row major, values in [0, label_cnt)
+	void Build(const int* labels, int height, int width, int label_cnt) {
+		h = height, w = width, m_labels = labels;
+		chains.clear();
+		m_hvisited.assign((size_t)(h + 1) * w, 0);
+		m_vvisited.assign((size_t)h * (w + 1), 0);
+
+		//1. chains between nodes====
+		for (int y = 0; y <= h; y++)
+			for (int x = 0; x <= w; x++)
+				if (Degree(x, y) > 2)
+					for (int d = 0; d < 4; d++)
+						if (HasEdge(x, y, d) && !Visited(x, y, d)) Walk(x, y, d, true);
+
+		//2. closed chains, every one has a horizontal crack edge====
+		for (int y = 0; y <= h; y++)
+			for (int x = 0; x < w; x++)
+				if (!m_hvisited[(size_t)y * w + x] && HasEdge(x, y, 0)) Walk(x, y, 0, false);
+
+		label_chains.assign(label_cnt, vector<int>());
+		for (int i = 0; i < chains.size(); i++) {
+			if (chains[i].left >= 0) label_chains[chains[i].left].push_back(i);
+			if (chains[i].right >= 0) label_chains[chains[i].right].push_back(i);
+		}
+		m_labels = nullptr;
+		vector<uint8_t>().swap(m_hvisited);
+		vector<uint8_t>().swap(m_vvisited);
+	}
+
+	void FitChains(double tolerance, int corner_run = 3) {
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < (int)chains.size(); i++) {
+			BoundaryChain& chain = chains[i];
+			chain.curve = chain.start_node < 0 ? FitClosedCornerPolygon(chain.corners, tolerance, corner_run)
+				: FitOpenCornerChain(chain.corners, tolerance, corner_run);
+		}
+	}
+
+	//closed outlines of the union of the labels in_set, with the union on the right of each loop (so outer
+	//loops are clockwise on screen and holes counterclockwise); labels: the labels in the set, each once
+	template<typename Labels>
+	vector<vector<BezierSegment>> Outline(const vector<uint8_t>& in_set, const Labels& labels) const {
+		auto inside = [&](int label) { return label >= 0 && in_set[label]; };
+
+		//1. chains with the set on exactly one side, oriented to have it on the right====
+		struct Oriented { int chain; bool reversed; int from, to, first_dir, last_dir; };
+		vector<Oriented> parts;
+		vector<vector<BezierSegment>> loops;
+		for (int label : labels) {
+			for (int ci : label_chains[label]) {
+				const BoundaryChain& c = chains[ci];
+				bool in_right = inside(c.right);
+				if (in_right == inside(c.left) || (!in_right && c.left != label) || (in_right && c.right != label))
+					continue;	//interior chain, or listed under the label of the other side
+				if (c.start_node < 0) {
+					loops.push_back(vector<BezierSegment>());
+					if (in_right) loops.back() = c.curve;
+					else AppendReversed(c.curve, loops.back());
+				}
+				else if (in_right)
+					parts.push_back({ ci, false, c.start_node, c.end_node, c.start_dir, c.end_dir });
+				else
+					parts.push_back({ ci, true, c.end_node, c.start_node, (c.end_dir + 2) % 4, (c.start_dir + 2) % 4 });
+			}
+		}
+
+		//2. link the chains at the nodes into loops; where the set touches itself diagonally,
+		//turn right first, as a 4-connected trace would====
+		unordered_map<int, vector<int>> leaving;
+		for (int i = 0; i < parts.size(); i++) leaving[parts[i].from].push_back(i);
+		vector<bool> used(parts.size(), false);
+		for (int s = 0; s < parts.size(); s++) {
+			if (used[s]) continue;
+			vector<BezierSegment> loop;
+			int cur = s;
+			while (true) {
+				used[cur] = true;
+				const Oriented& p = parts[cur];
+				if (p.reversed) AppendReversed(chains[p.chain].curve, loop);
+				else loop.insert(loop.end(), chains[p.chain].curve.begin(), chains[p.chain].curve.end());
+
+				int next = -1;
+				for (int t : { 1, 0, 3 }) {
+					for (int cand : leaving[p.to])
+						if ((cand == s || !used[cand]) && parts[cand].first_dir == (p.last_dir + t) % 4) next = cand;
+					if (next >= 0) break;
+				}
+				if (next < 0 || next == s) break;
+				cur = next;
+			}
+			loops.push_back(loop);
+		}
+		return loops;
+	}
+};
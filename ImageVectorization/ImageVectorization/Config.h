@@ -0,0 +1,216 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+//all tunables of a run; the defaults are the "balanced" preset, which is the original setting
+struct VectorizationConfig {
+	//input and scheduling
+	vector<string>	data_dirs = { "../Data/1-Syn1" };
+	string			manifest_path;						//batch mode when set, one data directory per line
+	int				thread_cnt = 0;						//batch mode pool size, 0: all cores
+	bool			preprocess_in_process = false;		//preprocess seg.png and mask.png in memory even when the region files exist
+	bool			save_intermediate_files = false;	//write region.png, region_index.png, region_info.txt and region.bin
+	int				tile_size = 0;						//> 0: map the input as tiles of tile_size pixels (input.tiles); needs the region.bin of ProcessRegionSegImg
+	unsigned		seed = 600;							//seeds the random region colors of the preprocessing
+	bool			deterministic = false;				//print per-configuration lines and batch case reports in a fixed order
+
+	//1. region supporting trees: the depth limit grows from min_tree_depth until trees are found
+	int				min_tree_depth = 3;
+	int				max_tree_depth = 8;
+	int				l1_node_divisor = 3;				//at most region cnt / divisor nodes right under the canvas
+	int				relaxed_l1_node_divisor = 2;		//used when fewer than 2 trees are found
+	int				max_group_regions = 0;				//> 0: hierarchical mode above this region cnt, groups of at most this many regions
+	int				group_max_eval = 100;				//hierarchical mode: L-BFGS evaluations to score each tree of a group
+
+	//3. layer parameter optimization
+	int				sample_n = 30;						//sampled pixels per region
+	int				max_eval = 1000;					//L-BFGS evaluations per configuration
+	double			xtol = 1e-5;						//relative parameter tolerance of L-BFGS
+	double			w_recon = 20.0;
+	double			w_gamut = 10.0;
+	double			w_complexity = 0.02;
+
+	//4. output
+	int				output_cnt = 5;						//top results written per case
+	bool			write_svg = true;					//write results/<i>.svg, the layers as traced and fitted vector shapes
+	double			svg_fit_tolerance = 0.5;			//max distance of the fitted curves from the traced outlines, in pixels
+	string			layer_format = "preview";			//preview: results/<i>.png over the chessboard; rgba or premultiplied: results/<i>/layer_<k>.png
+	bool			layer_preview = false;				//with rgba layers, write the chessboard preview too
+	string			mask_format = "png";				//object masks for Gen_svg_script: png (one 1-bit PNG each), packed (one masks.bin) or none
+	string			metrics_path;						//append per-case timings and counters as JSON lines when set
+};
+
+//"fast" trades quality for latency, "quality" the other way round
+inline bool ApplyPreset(VectorizationConfig& cfg, string name) {
+	if (name == "fast") {
+		cfg.max_tree_depth = 5;
+		cfg.sample_n = 15;
+		cfg.max_eval = 300;
+		cfg.group_max_eval = 30;
+		cfg.xtol = 1e-4;
+		cfg.output_cnt = 1;
+	}
+	else if (name == "balanced") {
+		cfg.max_tree_depth = 8;
+		cfg.sample_n = 30;
+		cfg.max_eval = 1000;
+		cfg.group_max_eval = 100;
+		cfg.xtol = 1e-5;
+		cfg.output_cnt = 5;
+	}
+	else if (name == "quality") {
+		cfg.max_tree_depth = 10;
+		cfg.sample_n = 60;
+		cfg.max_eval = 3000;
+		cfg.group_max_eval = 300;
+		cfg.xtol = 1e-6;
+		cfg.output_cnt = 5;
+	}
+	else {
+		cout << "unknown preset: " << name << endl;
+		return false;
+	}
+	return true;
+}
+
+//set one tunable by name, '-' and '_' are interchangeable
+inline bool SetConfigValue(VectorizationConfig& cfg, string key, string value) {
+	replace(key.begin(), key.end(), '-', '_');
+	istringstream iss(value);
+	bool ok = true;
+	if (key == "preset") ok = ApplyPreset(cfg, value);
+	else if (key == "manifest") cfg.manifest_path = value;
+	else if (key == "threads") ok = (bool)(iss >> cfg.thread_cnt) && cfg.thread_cnt >= 0;
+	else if (key == "preprocess_in_process") ok = (bool)(iss >> cfg.preprocess_in_process);
+	else if (key == "save_intermediate_files") ok = (bool)(iss >> cfg.save_intermediate_files);
+	else if (key == "tile_size") ok = (bool)(iss >> cfg.tile_size) && cfg.tile_size >= 0;
+	else if (key == "seed") ok = (bool)(iss >> cfg.seed);
+	else if (key == "deterministic") ok = (bool)(iss >> cfg.deterministic);
+	else if (key == "min_tree_depth") ok = (bool)(iss >> cfg.min_tree_depth) && cfg.min_tree_depth > 0;
+	else if (key == "max_tree_depth") ok = (bool)(iss >> cfg.max_tree_depth) && cfg.max_tree_depth > 0;
+	else if (key == "l1_node_divisor") ok = (bool)(iss >> cfg.l1_node_divisor) && cfg.l1_node_divisor > 0;
+	else if (key == "relaxed_l1_node_divisor") ok = (bool)(iss >> cfg.relaxed_l1_node_divisor) && cfg.relaxed_l1_node_divisor > 0;
+	else if (key == "max_group_regions") ok = (bool)(iss >> cfg.max_group_regions) && cfg.max_group_regions >= 0;
+	else if (key == "group_max_eval") ok = (bool)(iss >> cfg.group_max_eval) && cfg.group_max_eval > 0;
+	else if (key == "sample_n") ok = (bool)(iss >> cfg.sample_n) && cfg.sample_n > 0;
+	else if (key == "max_eval") ok = (bool)(iss >> cfg.max_eval) && cfg.max_eval > 0;
+	else if (key == "xtol") ok = (bool)(iss >> cfg.xtol) && cfg.xtol > 0;
+	else if (key == "w_recon") ok = (bool)(iss >> cfg.w_recon);
+	else if (key == "w_gamut") ok = (bool)(iss >> cfg.w_gamut);
+	else if (key == "w_complexity") ok = (bool)(iss >> cfg.w_complexity);
+	else if (key == "output_cnt") ok = (bool)(iss >> cfg.output_cnt) && cfg.output_cnt >= 0;
+	else if (key == "write_svg") ok = (bool)(iss >> cfg.write_svg);
+	else if (key == "svg_fit_tolerance") ok = (bool)(iss >> cfg.svg_fit_tolerance) && cfg.svg_fit_tolerance > 0;
+	else if (key == "layer_format") {
+		ok = value == "preview" || value == "rgba" || value == "premultiplied";
+		if (ok) cfg.layer_format = value;
+	}
+	else if (key == "layer_preview") ok = (bool)(iss >> cfg.layer_preview);
+	else if (key == "mask_format") {
+		ok = value == "png" || value == "packed" || value == "none";
+		if (ok) cfg.mask_format = value;
+	}
+	else if (key == "metrics") cfg.metrics_path = value;
+	else {
+		cout << "unknown option: " << key << endl;
+		return false;
+	}
+	if (!ok) cout << "invalid value for " << key << ": " << value << endl;
+	return ok;
+}
+
+//"key = value" lines, '#' starts a comment
+inline bool LoadConfigFile(VectorizationConfig& cfg, string path) {
+	ifstream ifs(path);
+	if (!ifs) {
+		cout << "can not open config file: " << path << endl;
+		return false;
+	}
+	string line;
+	while (getline(ifs, line)) {
+		line = line.substr(0, line.find('#'));
+		size_t eq = line.find('=');
+		if (eq == string::npos) continue;
+		string key = line.substr(0, eq), value = line.substr(eq + 1);
+		key.erase(0, key.find_first_not_of(" \t"));
+		key.erase(key.find_last_not_of(" \t\r") + 1);
+		value.erase(0, value.find_first_not_of(" \t"));
+		value.erase(value.find_last_not_of(" \t\r") + 1);
+		if (!SetConfigValue(cfg, key, value)) return false;
+	}
+	return true;
+}
+
+//the checks that involve several tunables, once all of them are set
+inline bool CheckConfig(const VectorizationConfig& cfg) {
+	if (cfg.min_tree_depth > cfg.max_tree_depth) {
+		cout << "min_tree_depth (" << cfg.min_tree_depth << ") is above max_tree_depth (" << cfg.max_tree_depth << ")" << endl;
+		return false;
+	}
+	return true;
+}
+
+inline void PrintUsage() {
+	cout << "usage: ImageVectorization [options] [data_dir ...]\n"
+		"  --preset fast|balanced|quality\n"
+		"  --config <file>                  key = value lines with the option names below\n"
+		"  --manifest <file>                batch mode, one data directory per line\n"
+		"  --threads <n>                    batch mode pool size, 0: all cores\n"
+		"  --preprocess-in-process 0|1      segment seg.png and mask.png even when region.bin or region_info.txt exist\n"
+		"  --save-intermediate-files 0|1    write the region files of an in-process segmentation\n"
+		"  --tile-size <pixels>             map the input as tiles, 0: off; needs region.bin from ProcessRegionSegImg,\n"
+		"                                   as the input is not segmented in process in this mode\n"
+		"  --seed <n>                       --deterministic 0|1   log lines and case reports in a fixed order\n"
+		"  --min-tree-depth <n>             --max-tree-depth <n>\n"
+		"  --l1-node-divisor <n>            --relaxed-l1-node-divisor <n>\n"
+		"  --max-group-regions <n>          above n regions, order groups of at most n regions separately, 0: off\n"
+		"  --group-max-eval <n>             L-BFGS evaluations to score each tree of a group\n"
+		"  --sample-n <n>                   --max-eval <n>        --xtol <x>\n"
+		"  --w-recon <x>                    --w-gamut <x>         --w-complexity <x>\n"
+		"  --output-cnt <n>                 --metrics <file>      append per-case timings and counters as JSON lines\n"
+		"  --write-svg 0|1                  --svg-fit-tolerance <pixels>\n"
+		"  --layer-format preview|rgba|premultiplied   layers over the chessboard, or as RGBA PNGs\n"
+		"  --layer-preview 0|1              with RGBA layers, write the chessboard preview too\n"
+		"  --mask-format png|packed|none    object masks as 1-bit PNGs, one masks.bin per result, or none\n"
+		"options are applied in order, so a later option overrides a preset or config file given before it" << endl;
+}
+
+//false on a bad argument or --help
+inline bool ParseCommandLine(int argc, char** argv, VectorizationConfig& cfg) {
+	vector<string> data_dirs;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "-h" || arg == "--help") {
+			PrintUsage();
+			return false;
+		}
+		if (arg.compare(0, 2, "--") != 0) {
+			data_dirs.push_back(arg);
+			continue;
+		}
+		if (i + 1 >= argc) {
+			cout << "missing value for " << arg << endl;
+			PrintUsage();
+			return false;
+		}
+		string value = argv[++i];
+		bool ok = (arg == "--config") ? LoadConfigFile(cfg, value) : SetConfigValue(cfg, arg.substr(2), value);
+		if (!ok) {
+			PrintUsage();
+			return false;
+		}
+	}
+	if (!data_dirs.empty()) cfg.data_dirs = data_dirs;
+	if (!CheckConfig(cfg)) {
+		PrintUsage();
+		return false;
+	}
+	return true;
+}
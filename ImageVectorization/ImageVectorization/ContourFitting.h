@@ -0,0 +1,285 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+//Outlines as paths of cubic Bezier curves fitted to pixel boundaries, in place of potrace.
+//Coordinates are pixel corners, x = column, y = row, so pixel (r, c) is the square (c, r) - (c + 1, r + 1).
+
+struct BezierSegment {
+	Vec2d p0, c1, c2, p3;
+	bool is_line = false;
+};
+
+//crack edge directions, clockwise on screen: east, south, west, north
+static const int kCrackDx[4] = { 1, 0, -1, 0 };
+static const int kCrackDy[4] = { 0, 1, 0, -1 };
+
+//Points to fit along a corner polygon: the midpoint of every side, which turns one-pixel stairs into slopes,
+//plus the corners between two sides of at least corner_run pixels, which are kept sharp.
+inline void SmoothCornerPolygon(const vector<Vec2i>& corners, vector<Vec2d>& points, vector<bool>& is_sharp, int corner_run = 3) {
+	points.clear();
+	is_sharp.clear();
+	int n = corners.size();
+	auto side_len = [&](int i) {
+		Vec2i a = corners[i], b = corners[(i + 1) % n];
+		return abs(a[0] - b[0]) + abs(a[1] - b[1]);
+	};
+	for (int i = 0; i < n; i++) {
+		int prev = (i + n - 1) % n;
+		if (side_len(prev) >= corner_run && side_len(i) >= corner_run) {
+			points.push_back(Vec2d(corners[i][0], corners[i][1]));
+			is_sharp.push_back(true);
+		}
+		Vec2i a = corners[i], b = corners[(i + 1) % n];
+		points.push_back(Vec2d(0.5 * (a[0] + b[0]), 0.5 * (a[1] + b[1])));
+		is_sharp.push_back(false);
+	}
+}
+
+//least squares cubic Bezier fitting of digitized curves (Schneider, Graphics Gems 1990)===================
+class BezierFitter {
+private:
+	const vector<Vec2d>&	m_pts;
+	double					m_tol2;
+	vector<BezierSegment>&	m_out;
+
+	static Vec2d Normalized(Vec2d v) {
+		double len = norm(v);
+		return len > 1e-12 ? v / len : Vec2d(0, 0);
+	}
+
+	static Vec2d Eval(const Vec2d* b, int degree, double t) {
+		Vec2d tmp[4];
+		for (int i = 0; i <= degree; i++) tmp[i] = b[i];
+		for (int i = 1; i <= degree; i++)
+			for (int j = 0; j <= degree - i; j++)
+				tmp[j] = (1 - t) * tmp[j] + t * tmp[j + 1];
+		return tmp[0];
+	}
+
+	vector<double> ChordLengthParams(int first, int last) {
+		vector<double> u(last - first + 1, 0);
+		for (int i = first + 1; i <= last; i++)
+			u[i - first] = u[i - first - 1] + norm(m_pts[i] - m_pts[i - 1]);
+		for (int i = first + 1; i <= last; i++)
+			u[i - first] = u.back() > 0 ? u[i - first] / u.back() : 0;
+		return u;
+	}
+
+	BezierSegment GenerateBezier(int first, int last, const vector<double>& u, Vec2d t1, Vec2d t2) {
+		double C[2][2] = { { 0, 0 }, { 0, 0 } }, X[2] = { 0, 0 };
+		Vec2d p0 = m_pts[first], p3 = m_pts[last];
+		for (int i = 0; i < u.size(); i++) {
+			double t = u[i], mt = 1 - t;
+			double b0 = mt * mt * mt, b1 = 3 * t * mt * mt, b2 = 3 * t * t * mt, b3 = t * t * t;
+			Vec2d a1 = t1 * b1, a2 = t2 * b2;
+			C[0][0] += a1.dot(a1), C[0][1] += a1.dot(a2), C[1][1] += a2.dot(a2);
+			Vec2d tmp = m_pts[first + i] - (p0 * (b0 + b1) + p3 * (b2 + b3));
+			X[0] += a1.dot(tmp), X[1] += a2.dot(tmp);
+		}
+		C[1][0] = C[0][1];
+		double det = C[0][0] * C[1][1] - C[1][0] * C[0][1];
+		double alpha1 = 0, alpha2 = 0;
+		if (fabs(det) > 1e-12) {
+			alpha1 = (X[0] * C[1][1] - X[1] * C[0][1]) / det;
+			alpha2 = (C[0][0] * X[1] - C[1][0] * X[0]) / det;
+		}
+		//degenerate or backwards handles: fall back to the Wu/Barsky heuristic
+		double seg_len = norm(p3 - p0), eps = 1e-6 * seg_len;
+		if (alpha1 < eps || alpha2 < eps)
+			alpha1 = alpha2 = seg_len / 3;
+
+		BezierSegment seg;
+		seg.p0 = p0, seg.p3 = p3;
+		seg.c1 = p0 + t1 * alpha1;
+		seg.c2 = p3 + t2 * alpha2;
+		return seg;
+	}
+
+	double MaxError(int first, int last, const BezierSegment& seg, const vector<double>& u, int& split) {
+		Vec2d b[4] = { seg.p0, seg.c1, seg.c2, seg.p3 };
+		double max_dist = 0;
+		split = (first + last) / 2;
+		for (int i = first + 1; i < last; i++) {
+			Vec2d d = Eval(b, 3, u[i - first]) - m_pts[i];
+			double dist = d.dot(d);
+			if (dist >= max_dist) max_dist = dist, split = i;
+		}
+		return max_dist;
+	}
+
+	//one Newton-Raphson step towards the closest point of the curve
+	static double NewtonRoot(const BezierSegment& seg, Vec2d p, double u) {
+		Vec2d q[4] = { seg.p0, seg.c1, seg.c2, seg.p3 };
+		Vec2d q1[3], q2[2];
+		for (int i = 0; i < 3; i++) q1[i] = (q[i + 1] - q[i]) * 3.0;
+		for (int i = 0; i < 2; i++) q2[i] = (q1[i + 1] - q1[i]) * 2.0;
+		Vec2d qu = Eval(q, 3, u), q1u = Eval(q1, 2, u), q2u = Eval(q2, 1, u);
+		double num = (qu - p).dot(q1u);
+		double den = q1u.dot(q1u) + (qu - p).dot(q2u);
+		return fabs(den) < 1e-12 ? u : u - num / den;
+	}
+
+	void FitCubic(int first, int last, Vec2d t1, Vec2d t2) {
+		if (last - first == 1) {
+			BezierSegment seg;
+			seg.p0 = m_pts[first], seg.p3 = m_pts[last];
+			double d = norm(seg.p3 - seg.p0) / 3;
+			seg.c1 = seg.p0 + t1 * d, seg.c2 = seg.p3 + t2 * d;
+			m_out.push_back(seg);
+			return;
+		}
+
+		vector<double> u = ChordLengthParams(first, last);
+		BezierSegment seg = GenerateBezier(first, last, u, t1, t2);
+		int split;
+		double err = MaxError(first, last, seg, u, split);
+		if (err < m_tol2) {
+			m_out.push_back(seg);
+			return;
+		}
+		if (err < 4 * m_tol2) {
+			for (int iter = 0; iter < 4; iter++) {
+				for (int i = first; i <= last; i++)
+					u[i - first] = NewtonRoot(seg, m_pts[i], u[i - first]);
+				seg = GenerateBezier(first, last, u, t1, t2);
+				err = MaxError(first, last, seg, u, split);
+				if (err < m_tol2) {
+					m_out.push_back(seg);
+					return;
+				}
+			}
+		}
+
+		split = max(first + 1, min(last - 1, split));
+		Vec2d tc = Normalized(m_pts[split - 1] - m_pts[split + 1]);
+		FitCubic(first, split, t1, tc);
+		FitCubic(split, last, -tc, t2);
+	}
+
+public:
+	BezierFitter(const vector<Vec2d>& pts, double tolerance, vector<BezierSegment>& out) : m_pts(pts), m_tol2(tolerance * tolerance), m_out(out) {}
+
+	//fit pts[first..last]; t1 points from the first point into the curve, t2 from the last point back into it.
+	//Nearly straight runs become lines.
+	void Fit(int first, int last, Vec2d t1, Vec2d t2) {
+		if (last <= first) return;
+		Vec2d a = m_pts[first], b = m_pts[last], ab = b - a;
+		double len = norm(ab), max_dev = 0;
+		for (int i = first + 1; i < last && len > 0; i++) {
+			Vec2d ap = m_pts[i] - a;
+			max_dev = max(max_dev, fabs(ab[0] * ap[1] - ab[1] * ap[0]) / len);
+		}
+		if (len > 0 && max_dev * max_dev < m_tol2 * 0.25) {
+			BezierSegment seg;
+			seg.p0 = a, seg.p3 = b, seg.c1 = a + ab / 3.0, seg.c2 = b - ab / 3.0;
+			seg.is_line = true;
+			m_out.push_back(seg);
+			return;
+		}
+		FitCubic(first, last, Normalized(t1), Normalized(t2));
+	}
+
+	static Vec2d Tangent(Vec2d from, Vec2d to) {
+		return Normalized(to - from);
+	}
+};
+
+//Bezier segments of one closed corner polygon: sharp corners split the curve, a loop without sharp
+//corners is cut at its first point with a tangent through both neighbors, so the seam stays smooth.
+inline vector<BezierSegment> FitClosedCornerPolygon(const vector<Vec2i>& corners, double tolerance, int corner_run = 3) {
+	vector<Vec2d> pts;
+	vector<bool> is_sharp;
+	SmoothCornerPolygon(corners, pts, is_sharp, corner_run);
+	int n = pts.size();
+
+	int start = 0;
+	while (start < n && !is_sharp[start]) start++;
+	bool smooth_loop = start == n;
+	if (smooth_loop) start = 0;
+
+	//rotate so that the loop starts at a breakpoint, and close it by repeating the start point
+	vector<Vec2d> loop(pts.begin() + start, pts.end());
+	loop.insert(loop.end(), pts.begin(), pts.begin() + start);
+	vector<bool> sharp(is_sharp.begin() + start, is_sharp.end());
+	sharp.insert(sharp.end(), is_sharp.begin(), is_sharp.begin() + start);
+	loop.push_back(loop[0]);
+	sharp.push_back(true);
+
+	vector<BezierSegment> segs;
+	BezierFitter fitter(loop, tolerance, segs);
+	Vec2d seam = BezierFitter::Tangent(loop[n - 1], loop[1]);
+	int first = 0;
+	for (int i = 1; i <= n; i++) {
+		if (!sharp[i]) continue;
+		Vec2d t1 = (first == 0 && smooth_loop) ? seam : BezierFitter::Tangent(loop[first], loop[first + 1]);
+		Vec2d t2 = (i == n && smooth_loop) ? -seam : BezierFitter::Tangent(loop[i], loop[i - 1]);
+		fitter.Fit(first, i, t1, t2);
+		first = i;
+	}
+	return segs;
+}
+
+//Bezier segments of an open corner chain whose end points are fixed, e.g. junctions shared with other chains
+inline vector<BezierSegment> FitOpenCornerChain(const vector<Vec2i>& corners, double tolerance, int corner_run = 3) {
+	int n = corners.size();
+	vector<Vec2d> pts;
+	vector<bool> sharp;
+	auto side_len = [&](int i) { return abs(corners[i][0] - corners[i + 1][0]) + abs(corners[i][1] - corners[i + 1][1]); };
+	for (int i = 0; i < n; i++) {
+		if (i == 0 || i == n - 1 || (side_len(i - 1) >= corner_run && side_len(i) >= corner_run)) {
+			pts.push_back(Vec2d(corners[i][0], corners[i][1]));
+			sharp.push_back(true);
+		}
+		if (i + 1 < n) {
+			pts.push_back(Vec2d(0.5 * (corners[i][0] + corners[i + 1][0]), 0.5 * (corners[i][1] + corners[i + 1][1])));
+			sharp.push_back(false);
+		}
+	}
+
+	vector<BezierSegment> segs;
+	BezierFitter fitter(pts, tolerance, segs);
+	int first = 0;
+	for (int i = 1; i < pts.size(); i++) {
+		if (!sharp[i]) continue;
+		fitter.Fit(first, i, BezierFitter::Tangent(pts[first], pts[first + 1]), BezierFitter::Tangent(pts[i], pts[i - 1]));
+		first = i;
+	}
+	return segs;
+}
+
+//the same curve walked the other way
+inline void AppendReversed(const vector<BezierSegment>& segs, vector<BezierSegment>& out) {
+	for (int i = (int)segs.size() - 1; i >= 0; i--) {
+		BezierSegment s = segs[i];
+		swap(s.p0, s.p3);
+		swap(s.c1, s.c2);
+		out.push_back(s);
+	}
+}
+
+//SVG path data of closed loops, "M x y C ... Z" per loop
+inline string BezierLoopsToPathData(const vector<vector<BezierSegment>>& loops, int precision = 2) {
+	ostringstream os;
+	os << fixed << setprecision(precision);
+	for (const vector<BezierSegment>& segs : loops) {
+		if (segs.empty()) continue;
+		os << "M" << segs[0].p0[0] << " " << segs[0].p0[1];
+		for (const BezierSegment& s : segs) {
+			if (s.is_line) os << "L" << s.p3[0] << " " << s.p3[1];
+			else os << "C" << s.c1[0] << " " << s.c1[1] << " " << s.c2[0] << " " << s.c2[1] << " " << s.p3[0] << " " << s.p3[1];
+		}
+		os << "Z";
+	}
+	return os.str();
+}
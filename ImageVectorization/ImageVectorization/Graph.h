@@ -35,6 +35,8 @@ private:
     int max_tree_depth;
 
 public:
+    long long pruned_branch_cnt = 0;    //branches cut by the x-junction test
+
     Graph() {}
     Graph(int const _n, 
         vector<Vec2i> graph_edges = vector<Vec2i>(),
@@ -135,6 +137,8 @@ public:
                     ++xj_cnt[i];
                 if (x_junction_test(e.v, depth, xj_cnt, choices))
                     enum_tree(e.v, cand, k + 1, depth, cnt, xj_cnt, cnt2 + (depth[e.v] == 2), choices);
+                else
+                    pruned_branch_cnt++;
                 for (auto i : xj_p[e.v])
                     --xj_cnt[i];
                 depth[e.v] = 0;
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "Region.h"
+#include "RegionSupportingTree.h"
+#include "LayerMerging.h"
+#include "LayerVectorizing.h"
+#include "SharedBoundary.h"
+#include "Xjunction.h"
+#include "Tree.h"
+#include "Config.h"
+
+using namespace std;
+using namespace cv;
+
+//Hierarchical mode for images with many regions: the tree enumeration is exponential in the region cnt, so
+//the regions are clustered into groups that are loosely connected to each other, every group is ordered on
+//its own (in parallel), the groups are ordered among themselves, and the group trees are joined into one
+//tree of all regions, whose configuration is then optimized as a whole.
+
+struct RegionGroup {
+	vector<int>		rids;				//region ids, increasing; the local id of rids[k] is k + 1, 0 is the canvas
+	Tree			tree;				//the group's best tree, in local ids
+	double			loss = 0;			//loss of the group's configuration of that tree
+	int				tree_cnt = 0;		//valid trees of the group
+	int				parent = -1;		//group the group lies on, -1: the canvas
+	vector<vector<double>>	region_vars;	//optimizer vars of each region in that configuration, by local id
+};
+
+class HierarchicalDecomposition {
+public:
+	vector<RegionGroup>	groups;
+	vector<int>			group_of;		//group of each region, -1 for the canvas
+	vector<int>			local_of;		//local id of each region in its group
+
+public:
+	//1. union-find over the regions: the regions of an x-junction are put together first, as its order has
+	//to be decided within one group, then adjacent regions from the strongest connection down, as long as
+	//the group stays within max_group_regions; the strength is the shared boundary over the smaller perimeter
+	void ClusterRegions(const RegionInfo& info, int max_group_regions) {
+		int n = info.regions.size();
+		vector<int> parent(n), size(n, 1);
+		iota(parent.begin(), parent.end(), 0);
+		auto find = [&](int a) {
+			while (parent[a] != a) a = parent[a] = parent[parent[a]];
+			return a;
+		};
+		auto unite = [&](int a, int b) {
+			a = find(a), b = find(b);
+			if (a == b) return;
+			if (size[a] < size[b]) swap(a, b);
+			parent[b] = a;
+			size[a] += size[b];
+		};
+
+		for (const Vec4i& xj : info.xjunction.m_xjunctions) {
+			int first = -1;
+			for (int k = 0; k < 4; k++) {
+				if (xj[k] <= 0) continue;
+				if (first < 0) first = xj[k];
+				else unite(first, xj[k]);
+			}
+		}
+
+		struct Link { double strength; int a, b; };
+		vector<Link> links;
+		const SharedBoundaryTable& sb = info.shared_boundary;
+		for (int a = 1; a < n; a++) {
+			for (int k = 0; k < sb.NeighborCnt(a); k++) {
+				int b = sb.NeighborAt(a, k);
+				if (b <= a) continue;
+				double shared = max(sb.PixCntAt(a, k), sb.PixCnt(b, a));
+				double perimeter = max(1.0, min(info.regions[a].m_perimeter, info.regions[b].m_perimeter));
+				links.push_back({ shared / perimeter, a, b });
+			}
+		}
+		sort(links.begin(), links.end(), [](const Link& l1, const Link& l2) {
+			if (l1.strength != l2.strength) return l1.strength > l2.strength;
+			return l1.a != l2.a ? l1.a < l2.a : l1.b < l2.b;
+		});
+		for (const Link& l : links) {
+			int ra = find(l.a), rb = find(l.b);
+			if (ra != rb && size[ra] + size[rb] <= max_group_regions) unite(ra, rb);
+		}
+
+		//groups in the order of their smallest region id
+		groups.clear();
+		group_of.assign(n, -1);
+		local_of.assign(n, 0);
+		vector<int> root_group(n, -1);
+		for (int rid = 1; rid < n; rid++) {
+			int r = find(rid);
+			if (root_group[r] < 0) {
+				root_group[r] = groups.size();
+				groups.push_back(RegionGroup());
+			}
+			RegionGroup& G = groups[root_group[r]];
+			G.rids.push_back(rid);
+			group_of[rid] = root_group[r];
+			local_of[rid] = G.rids.size();
+		}
+	}
+
+	//2. order the regions of group g: its regions, adjacency, shared boundary and x-junctions are renumbered
+	//into a problem of their own, every valid tree of it is merged and scored on the group's pixels with a
+	//short optimization of group_max_eval evaluations, and the tree of the lowest loss is kept along with its
+	//params, which warm start the joint optimization; without a valid tree the regions lie on the canvas
+	void SolveGroup(int g, const RegionInfo& info, ImageObj* img, const VectorizationConfig& cfg) {
+		RegionGroup& G = groups[g];
+		int n = G.rids.size() + 1;
+		auto local = [&](int rid) { return rid == 0 ? 0 : (group_of[rid] == g ? local_of[rid] : -1); };
+
+		if (n == 2) {
+			G.tree = Tree(n, { Vec2i(0, 1) });
+			G.tree_cnt = 1;
+			return;
+		}
+
+		//2.1 the group's problem====
+		vector<Region> regions(n);
+		regions[0].m_region_id = 0;
+		regions[0].m_layer_params = info.regions[0].m_layer_params;
+		SharedBoundaryTable shared_boundary;
+		shared_boundary.EndRegion();
+		vector<int> bottom_rids, border_rids;
+		for (int k = 1; k < n; k++) {
+			const Region& R = info.regions[G.rids[k - 1]];
+			regions[k] = R;
+			regions[k].m_region_id = k;
+			regions[k].m_is_at_bottom = false;
+			regions[k].m_adj_regions.clear();
+			regions[0].m_adj_regions.insert(k);
+
+			bool touches_other_group = false;
+			for (int adj : R.m_adj_regions) {
+				if (local(adj) >= 0) regions[k].m_adj_regions.insert(local(adj));
+				else touches_other_group = true;
+			}
+			for (int j = 0; j < info.shared_boundary.NeighborCnt(R.m_region_id); j++) {
+				int nb = local(info.shared_boundary.NeighborAt(R.m_region_id, j));
+				if (nb >= 0) shared_boundary.PushBack(nb, info.shared_boundary.PixCntAt(R.m_region_id, j));
+			}
+			shared_boundary.EndRegion();
+
+			if (find(info.possible_bottom_rids.begin(), info.possible_bottom_rids.end(), R.m_region_id) != info.possible_bottom_rids.end())
+				bottom_rids.push_back(k);
+			else if (touches_other_group)
+				border_rids.push_back(k);
+		}
+		//the group's bottom: the case's bottom regions when the group has some, otherwise the regions
+		//that border other groups, which may lie on the group below
+		if (bottom_rids.empty()) bottom_rids = border_rids;
+		if (bottom_rids.size() == 1) regions[bottom_rids[0]].m_is_at_bottom = true;
+
+		vector<Vec4i> xjunctions;
+		for (const Vec4i& xj : info.xjunction.m_xjunctions) {
+			Vec4i lxj(local(xj[0]), local(xj[1]), local(xj[2]), local(xj[3]));
+			if (lxj[0] >= 0 && lxj[1] >= 0 && lxj[2] >= 0 && lxj[3] >= 0 && (xj[0] > 0 || xj[1] > 0 || xj[2] > 0 || xj[3] > 0))
+				xjunctions.push_back(lxj);
+		}
+		Xjunction xjunction(xjunctions);
+
+		//2.2 the group's trees====
+		RegionSupportingTree rst(*img, regions, shared_boundary, xjunction, bottom_rids);
+		rst.SetTreeSearchLimits(cfg.min_tree_depth, cfg.max_tree_depth, cfg.l1_node_divisor, cfg.relaxed_l1_node_divisor);
+		rst.BuildAdjacentRegionGraph();
+		rst.GetValidRegionSupportingTrees();
+		vector<Tree>& trees = rst.m_valid_region_support_trees;
+		G.tree_cnt = trees.size();
+		if (trees.empty()) {
+			vector<Vec2i> edges;
+			for (int k = 1; k < n; k++) edges.push_back(Vec2i(0, k));
+			G.tree = Tree(n, edges);
+			return;
+		}
+
+		//2.3 the configuration of every tree, duplicates skipped, on the group's regions====
+		vector<LayerMerging> lms;
+		G.loss = 1e8;
+		for (Tree& tree : trees) {
+			LayerMerging lm(tree);
+			lm.DetermineLayerRange();
+			bool duplicate = false;
+			for (LayerMerging& prev : lms) duplicate = duplicate || prev.LayerConfigurationEquals(lm);
+			if (duplicate) continue;
+			lms.push_back(lm);
+
+			LayerVectorizing lv(&regions, img, lm.GetLayerObject());
+			lv.m_sample_n = cfg.sample_n;
+			lv.m_max_eval = cfg.group_max_eval;
+			lv.m_xtol = cfg.xtol;
+			lv.m_wr = cfg.w_recon;
+			lv.m_wg = cfg.w_gamut;
+			lv.m_wc = cfg.w_complexity;
+			lv.CalculateLayerObjectParamsWithGlobalOptimization();
+			lv.CalculateTotalLoss();
+			if (lms.size() == 1 || lv.m_total_loss < G.loss) {
+				G.loss = lv.m_total_loss;
+				G.tree = tree;
+				G.region_vars = lv.m_region_vars;
+			}
+		}
+	}
+
+	//3. order the groups: a group lies on the canvas when it holds a bottom region of the case, the others
+	//are attached one at a time by the strongest shared boundary to a group already placed that could support
+	//them (the size and enclosure rules of Region::CouldSupport, on the groups' areas and bboxes)
+	void OrderGroups(const RegionInfo& info) {
+		int k_cnt = groups.size();
+		vector<double> area(k_cnt, 0);
+		vector<Vec4i> bbox(k_cnt, Vec4i(INT_MAX, INT_MAX, -1, -1));
+		vector<map<int, double>> links(k_cnt);
+		for (int g = 0; g < k_cnt; g++) {
+			for (int rid : groups[g].rids) {
+				const Region& R = info.regions[rid];
+				area[g] += R.PixelCnt();
+				bbox[g] = Vec4i(min(bbox[g][0], R.m_bbox[0]), min(bbox[g][1], R.m_bbox[1]), max(bbox[g][2], R.m_bbox[2]), max(bbox[g][3], R.m_bbox[3]));
+				for (int j = 0; j < info.shared_boundary.NeighborCnt(rid); j++) {
+					int nb = info.shared_boundary.NeighborAt(rid, j);
+					if (nb > 0 && group_of[nb] != g) links[g][group_of[nb]] += info.shared_boundary.PixCntAt(rid, j);
+				}
+			}
+		}
+		auto encloses = [&](int a, int b) {
+			return bbox[a][0] <= bbox[b][0] && bbox[a][1] <= bbox[b][1] && bbox[a][2] >= bbox[b][2] && bbox[a][3] >= bbox[b][3];
+		};
+		auto could_support = [&](int a, int b) {
+			if (encloses(a, b)) return true;
+			if (encloses(b, a)) return false;
+			return area[a] >= area[b] * 2.0 / 3;
+		};
+
+		vector<bool> placed(k_cnt, false);
+		int placed_cnt = 0;
+		for (int rid : info.possible_bottom_rids)
+			if (rid > 0 && rid < group_of.size() && !placed[group_of[rid]]) placed[group_of[rid]] = true, placed_cnt++;
+		if (placed_cnt == 0 && k_cnt > 0) {
+			placed[max_element(area.begin(), area.end()) - area.begin()] = true;
+			placed_cnt++;
+		}
+		for (int g = 0; g < k_cnt; g++) groups[g].parent = -1;
+
+		while (placed_cnt < k_cnt) {
+			//the strongest link from a placed group that could support, else the strongest link at all
+			int best = -1, best_parent = -1;
+			double best_strength = -1;
+			bool best_supported = false;
+			for (int a = 0; a < k_cnt; a++) {
+				if (!placed[a]) continue;
+				for (auto& l : links[a]) {
+					int b = l.first;
+					if (placed[b]) continue;
+					bool supported = could_support(a, b);
+					if ((supported && !best_supported) || (supported == best_supported && l.second > best_strength)) {
+						best = b, best_parent = a, best_strength = l.second, best_supported = supported;
+					}
+				}
+			}
+			if (best < 0)	//not connected to the placed groups, on the canvas
+				best = find(placed.begin(), placed.end(), false) - placed.begin();
+			groups[best].parent = best_parent;
+			placed[best] = true;
+			placed_cnt++;
+		}
+	}
+
+	//the optimizer vars of every region in its group's configuration, by case id, empty for the regions of
+	//groups that were not optimized
+	vector<vector<double>> RegionVars(int region_cnt) const {
+		vector<vector<double>> vars(region_cnt);
+		for (const RegionGroup& G : groups)
+			for (int k = 1; k < G.region_vars.size(); k++) vars[G.rids[k - 1]] = G.region_vars[k];
+		return vars;
+	}
+
+	//4. one tree of all regions: the group trees in case ids, and the regions a group tree has on its canvas
+	//put on the region of the parent group they share the most boundary with (or that the whole group does).
+	//When the joined tree breaks an x-junction, the groups of its regions are attached as a whole to their
+	//anchor, which keeps the depths within the group, and then put on the canvas, as in their own tree;
+	//false if the x-junctions are still not satisfied
+	bool JoinGroupTrees(const RegionInfo& info, Tree& tree) {
+		vector<int> attach(groups.size(), 0);	//0: per region, 1: the group's anchor, 2: the canvas
+		while (true) {
+			tree = JoinedTree(info, attach);
+			if (tree.SatisfyAllXjunctionConstrains(info.xjunction.m_possible_configs))
+				return true;
+
+			vector<bool> moved(groups.size(), false);
+			bool changed = false;
+			for (const vector<Vec4i>& configs : info.xjunction.m_possible_configs) {
+				Vec4i ans;
+				if (tree.SatisfySingleXjunctionConstrain(configs, ans)) continue;
+				for (int k = 0; k < 4; k++) {
+					int rid = configs[0][k];
+					if (rid <= 0 || group_of[rid] < 0 || moved[group_of[rid]] || attach[group_of[rid]] == 2) continue;
+					moved[group_of[rid]] = true;
+					attach[group_of[rid]]++;
+					changed = true;
+				}
+			}
+			if (!changed) {
+				cout << "the joined tree does not satisfy all x-junctions" << endl;
+				return false;
+			}
+		}
+	}
+
+private:
+	Tree JoinedTree(const RegionInfo& info, const vector<int>& attach) {
+		int n = info.regions.size();
+		auto shared = [&](int a, int b) { return max(info.shared_boundary.PixCnt(a, b), info.shared_boundary.PixCnt(b, a)); };
+
+		vector<Vec2i> edges;
+		for (int g = 0; g < groups.size(); g++) {
+			RegionGroup& G = groups[g];
+			int parent = attach[g] == 2 ? -1 : G.parent;
+			int anchor = 0;
+			if (parent >= 0) {
+				int anchor_shared = -1;
+				for (int q : groups[parent].rids) {
+					int s = 0;
+					for (int rid : G.rids) s += shared(q, rid);
+					if (s > anchor_shared) anchor = q, anchor_shared = s;
+				}
+			}
+
+			for (const Vec2i& e : G.tree.GetEdgeList()) {
+				int v = G.rids[e[1] - 1];
+				if (e[0] > 0) {
+					edges.push_back(Vec2i(G.rids[e[0] - 1], v));
+					continue;
+				}
+				int u = anchor, u_shared = 0;
+				if (parent >= 0 && attach[g] == 0)
+					for (int q : groups[parent].rids)
+						if (shared(q, v) > u_shared) u = q, u_shared = shared(q, v);
+				edges.push_back(Vec2i(u, v));
+			}
+		}
+		sort(edges.begin(), edges.end(), edgecmp);
+		return Tree(n, edges);
+	}
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <time.h>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#endif
+
+using namespace std;
+
+inline double WallSeconds() {
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//CPU time of the whole process (summed over all threads) or of the calling thread only
+inline double CpuSeconds(bool this_thread_only) {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	BOOL ok = this_thread_only ? GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)
+		: GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	if (!ok) return 0;
+	auto seconds = [](FILETIME ft) { return (((unsigned long long)ft.dwHighDateTime << 32) | ft.dwLowDateTime) * 1e-7; };
+	return seconds(kernel) + seconds(user);
+#else
+	timespec ts;
+	if (clock_gettime(this_thread_only ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) return 0;
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+//high-water mark of the process's resident memory in bytes, since the start or the last ResetPeakMemory
+inline long long PeakMemoryBytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return (long long)pmc.PeakWorkingSetSize;
+#else
+#ifdef __linux__
+	//VmHWM is the same mark as ru_maxrss, but only VmHWM is reset by ResetPeakMemory
+	ifstream status("/proc/self/status");
+	string line;
+	while (getline(status, line))
+		if (line.compare(0, 6, "VmHWM:") == 0) return atoll(line.c_str() + 6) * 1024;
+#endif
+	rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+	return (long long)ru.ru_maxrss;
+#else
+	return (long long)ru.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+//restart the high-water mark at the current resident memory, after the freed heap is given back to the
+//system; false where that is not possible, then the mark covers the whole process
+inline bool ResetPeakMemory() {
+#ifdef __linux__
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+	ofstream of("/proc/self/clear_refs");
+	of << "5";
+	of.close();
+	return !of.fail();
+#else
+	return false;
+#endif
+}
+
+inline string JsonEscape(const string& s) {
+	string out;
+	for (char ch : s) {
+		if (ch == '"' || ch == '\\') out += '\\', out += ch;
+		else if (ch == '\n') out += "\\n";
+		else if ((unsigned char)ch < 0x20) out += ' ';
+		else out += ch;
+	}
+	return out;
+}
+
+//a JSON number, null for nan and inf
+inline string JsonNumber(double v) {
+	if (!isfinite(v)) return "null";
+	ostringstream os;
+	os << setprecision(6) << v;
+	return os.str();
+}
+
+struct StageRecord {
+	string	name;
+	double	wall = 0, cpu = 0;
+	int		task_cnt = 0;		//times the stage was entered, e.g. once per tree for merging
+};
+
+struct ConfigRecord {
+	int		config_id = 0;
+	double	wall = 0, cpu = 0;
+	int		layer_cnt = 0;
+	int		sample_cnt = 0;		//pixels sampled for the optimization
+	int		eval_cnt = 0;		//L-BFGS objective evaluations
+	double	loss = 0;
+};
+
+//per-case timings and counters, safe to fill from several threads
+class JobMetrics {
+private:
+	mutex					m_mutex;
+	vector<StageRecord>		m_stages;		//in the order they were first entered
+	map<string, long long>	m_counters;
+	vector<ConfigRecord>	m_configs;
+
+public:
+	void AddStage(const string& name, double wall, double cpu) {
+		lock_guard<mutex> lock(m_mutex);
+		for (StageRecord& s : m_stages) {
+			if (s.name != name) continue;
+			s.wall += wall, s.cpu += cpu, s.task_cnt++;
+			return;
+		}
+		m_stages.push_back({ name, wall, cpu, 1 });
+	}
+
+	void SetCounter(const string& name, long long value) {
+		lock_guard<mutex> lock(m_mutex);
+		m_counters[name] = value;
+	}
+
+	void AddConfig(const ConfigRecord& c) {
+		lock_guard<mutex> lock(m_mutex);
+		m_configs.push_back(c);
+	}
+
+	vector<StageRecord> Stages() {
+		lock_guard<mutex> lock(m_mutex);
+		return m_stages;
+	}
+
+	map<string, long long> Counters() {
+		lock_guard<mutex> lock(m_mutex);
+		return m_counters;
+	}
+
+	vector<ConfigRecord> Configs() {
+		lock_guard<mutex> lock(m_mutex);
+		vector<ConfigRecord> configs = m_configs;
+		sort(configs.begin(), configs.end(), [](const ConfigRecord& c1, const ConfigRecord& c2) { return c1.config_id < c2.config_id; });
+		return configs;
+	}
+
+	double TotalCpu() {
+		lock_guard<mutex> lock(m_mutex);
+		double t = 0;
+		for (StageRecord& s : m_stages) t += s.cpu;
+		return t;
+	}
+
+	//one JSON object on a single line
+	string ToJsonLine(const string& case_name, bool ok) {
+		lock_guard<mutex> lock(m_mutex);
+		ostringstream os;
+		os << setprecision(6);
+		os << "{\"case\":\"" << JsonEscape(case_name) << "\",\"ok\":" << (ok ? "true" : "false") << ",\"stages\":{";
+		for (int i = 0; i < m_stages.size(); i++) {
+			StageRecord& s = m_stages[i];
+			os << (i ? "," : "") << "\"" << JsonEscape(s.name) << "\":{\"wall\":" << s.wall << ",\"cpu\":" << s.cpu << ",\"tasks\":" << s.task_cnt << "}";
+		}
+		os << "},\"counters\":{";
+		int k = 0;
+		for (auto& kv : m_counters)
+			os << (k++ ? "," : "") << "\"" << JsonEscape(kv.first) << "\":" << kv.second;
+		os << "},\"configs\":[";
+		sort(m_configs.begin(), m_configs.end(), [](const ConfigRecord& c1, const ConfigRecord& c2) { return c1.config_id < c2.config_id; });
+		for (int i = 0; i < m_configs.size(); i++) {
+			ConfigRecord& c = m_configs[i];
+			os << (i ? "," : "") << "{\"id\":" << c.config_id << ",\"wall\":" << c.wall << ",\"cpu\":" << c.cpu << ",\"layers\":" << c.layer_cnt
+				<< ",\"samples\":" << c.sample_cnt << ",\"evals\":" << c.eval_cnt << ",\"loss\":" << JsonNumber(c.loss) << "}";
+		}
+		os << "]}";
+		return os.str();
+	}
+
+	//append the JSON line to path, lines of concurrent cases never interleave
+	void AppendJsonLine(const string& path, const string& case_name, bool ok) {
+		static mutex file_mutex;
+		string line = ToJsonLine(case_name, ok);
+		lock_guard<mutex> lock(file_mutex);
+		ofstream of(path, ios::app);
+		of << line << "\n";
+	}
+};
+
+//times a scope as one entry of a stage; this_thread_only: the stage runs in the calling thread only,
+//otherwise the CPU time of the whole process is taken, e.g. for stages with their own OpenMP loops
+class ScopedStage {
+private:
+	JobMetrics&	m_metrics;
+	string		m_name;
+	bool		m_this_thread_only;
+	double		m_wall0, m_cpu0;
+
+public:
+	ScopedStage(JobMetrics& metrics, string name, bool this_thread_only) : m_metrics(metrics), m_name(name), m_this_thread_only(this_thread_only) {
+		m_wall0 = WallSeconds();
+		m_cpu0 = CpuSeconds(m_this_thread_only);
+	}
+
+	double WallElapsed() const { return WallSeconds() - m_wall0; }
+	double CpuElapsed() const { return CpuSeconds(m_this_thread_only) - m_cpu0; }
+
+	~ScopedStage() {
+		m_metrics.AddStage(m_name, WallElapsed(), CpuElapsed());
+	}
+};
@@ -14,15 +14,14 @@ using namespace cv;
 
 class LayerMerging {
 private:
-	vector<Region> m_regions;
 	vector<Vec4i> m_xjunctions;
 	Graph m_reg_support_dag;
 	vector<vector<Object>> m_layer_objects; //a layer may contain several objects
 
 public:
 	LayerMerging() {}
-	LayerMerging(vector<Region> regions, Tree tree) {
-		m_regions = regions;
+	//the tree's vertex i is region i
+	LayerMerging(Tree tree) {
 		m_xjunctions = tree.m_meeted_xjconstrains;
 		m_reg_support_dag = Graph(tree.m_vn, tree.GetEdgeList());
 
@@ -30,14 +29,10 @@ public:
 		for (int i = 0; i < tree.m_vn; i++) {
 			int depth = tree.GetDepthOf(i);
 			set<int> rids; rids.insert(i);
-			m_layer_objects[depth].push_back(Object(m_regions[i].m_region_id, depth, rids));
+			m_layer_objects[depth].push_back(Object(i, depth, rids));
 		}
 	}
 
-	void Release() {
-		m_regions.swap(vector<Region>());
-	}
-
 	vector<vector<Object>> GetLayerObject() {
 		return m_layer_objects;
 	}
@@ -173,7 +168,7 @@ public:
 		}
 
 		//recursively include descendants' region
-		vector<int> obj_region_ids(1, m_regions[u].m_region_id);
+		vector<int> obj_region_ids(1, u);
 		vector<int> u_succ_verts = m_reg_support_dag.GetSucceessorsOf(u);
 		for (int i = 0; i < u_succ_verts.size(); i++) {
 			int v = u_succ_verts[i];
@@ -15,6 +15,7 @@ using namespace autodiff;
 
 typedef Eigen::Matrix<double, Eigen::Dynamic, 1> VectorMat;
 #define PI 3.141592653
+#define LOSS_BLOCK_SIZE 256		//parallel loss: sampled pixels summed together before the blocks are summed in order
 
 static dual E_recon(Vec2d& pos, vector<int>& oids, Vec3d& real_color, ObjectParams& params, double w_d, int pix_cnt);
 static dual E_gamut(Vec2d& pos, vector<int>& oids, ObjectParams& params, double w_g, int pix_cnt);
@@ -22,54 +23,105 @@ static double global_loss_function(unsigned n, const double* x, double* grad, vo
 
 class LayerParameterOptimization {
 public:
-	vector<Vec3d> m_img;
+	vector<Vec3d> m_sample_colors;				//input colors of the sampled pixels
 	vector<PixPassedObjects> m_pix_covered_objects;
 	ObjectParams m_params;
 	map<int, int> m_obj_lid_map;
 	double m_w_recon, m_w_gamut, m_recon_gamut_loss;
+	int m_max_eval;
+	int m_eval_cnt = 0;			//objective evaluations of the last optimization
+	double m_xtol;
+	bool m_parallel = false;	//evaluate the loss in blocks of pixels in parallel, see CalculateLossAndGradient
+	map<int, vector<double>> m_init_vars;	//warm start: the 9 vars of some objects by object id, the others start at the default
+
+private:
+	vector<double> m_block_losses, m_block_grads;	//parallel loss: per block, reused by all evaluations
 
 public:
 	LayerParameterOptimization(
-		vector<Vec3d>& img,
+		const ImageObj& img,
 		vector<PixPassedObjects>& pix_covered_objects,
 		int layer_cnt,
 		map<int, int>& obj_lid_map,
 		double w_r = 20,
-		double w_g = 10) {
+		double w_g = 10,
+		int max_eval = 1000,
+		double xtol = 1e-5) {
 
-		m_img = img;
 		m_pix_covered_objects = pix_covered_objects;
+		m_sample_colors.resize(pix_covered_objects.size());
+		for (int i = 0; i < pix_covered_objects.size(); i++)
+			m_sample_colors[i] = img.GetColor(pix_covered_objects[i].pix_id);
 		m_obj_lid_map = obj_lid_map;
 
 		m_w_recon = w_r;
 		m_w_gamut = w_g;
+		m_max_eval = max_eval;
+		m_xtol = xtol;
 	}
 
-	double CalculateLossAndGradientOfPix(int k) {
+	//the loss of the k-th pixel at params.vars, its gradient is added to grads
+	double CalculateLossAndGradientOfPix(int k, ObjectParams& params, double* grads) {
 		int pix_cnt = m_pix_covered_objects.size();
 
-		int pid = m_pix_covered_objects[k].pix_id;
 		Vec2d pos = m_pix_covered_objects[k].coord;
 
 		vector<int> covered_objects = m_pix_covered_objects[k].covered_objects;
-		Vec3d real_color = m_img[pid];
+		Vec3d real_color = m_sample_colors[k];
 
-		dual e_data = E_recon(pos, covered_objects, real_color, m_params, m_w_recon, pix_cnt);
+		dual e_data = E_recon(pos, covered_objects, real_color, params, m_w_recon, pix_cnt);
 		for (int i = 0; i < covered_objects.size(); i++) {
 			int oid = covered_objects[i];
 			for (int j = 9 * oid; j < 9 * (oid + 1); j++)
-				m_params.gradients[j] += (double)(derivative(E_recon, wrt(m_params.vars[j]), at(pos, covered_objects, real_color, m_params, m_w_recon, pix_cnt)));
+				grads[j] += (double)(derivative(E_recon, wrt(params.vars[j]), at(pos, covered_objects, real_color, params, m_w_recon, pix_cnt)));
 		}
 
-		dual e_gamut = E_gamut(pos, covered_objects, m_params, m_w_gamut, pix_cnt);
+		dual e_gamut = E_gamut(pos, covered_objects, params, m_w_gamut, pix_cnt);
 		for (int i = 0; i < covered_objects.size(); i++) {
 			int oid = covered_objects[i];
 			for (int j = 9 * oid; j < 9 * (oid + 1); j++)
-				m_params.gradients[j] += (double)(derivative(E_gamut, wrt(m_params.vars[j]), at(pos, covered_objects, m_params, m_w_gamut, pix_cnt)));
+				grads[j] += (double)(derivative(E_gamut, wrt(params.vars[j]), at(pos, covered_objects, params, m_w_gamut, pix_cnt)));
 		}
 		return (double)e_data + (double)e_gamut;
 	}
 
+	//the loss of all sampled pixels at m_params.vars, the gradient goes to m_params.gradients. Serially the pixels
+	//are summed in order. In parallel every block of LOSS_BLOCK_SIZE pixels is summed into its own gradient slice
+	//and the blocks are added in order, so the sums do not depend on the thread cnt or on which thread ran a block;
+	//derivative() seeds the vars it differentiates, so each thread works on its own copy of them
+	double CalculateLossAndGradient() {
+		int pix_cnt = m_pix_covered_objects.size(), n = m_params.vars.size();
+		fill(m_params.gradients.begin(), m_params.gradients.end(), 0.0);
+		double error = 0;
+		if (!m_parallel) {
+			for (int k = 0; k < pix_cnt; k++)
+				error += CalculateLossAndGradientOfPix(k, m_params, m_params.gradients.data());
+			return error;
+		}
+
+		int block_cnt = (pix_cnt + LOSS_BLOCK_SIZE - 1) / LOSS_BLOCK_SIZE;
+		m_block_losses.assign(block_cnt, 0);
+		m_block_grads.assign((size_t)block_cnt * n, 0);
+#pragma omp parallel if(block_cnt > 1)
+		{
+			ObjectParams params;
+			params.vars = m_params.vars;
+#pragma omp for schedule(dynamic)
+			for (int b = 0; b < block_cnt; b++) {
+				int end = min(pix_cnt, (b + 1) * LOSS_BLOCK_SIZE);
+				for (int k = b * LOSS_BLOCK_SIZE; k < end; k++)
+					m_block_losses[b] += CalculateLossAndGradientOfPix(k, params, &m_block_grads[(size_t)b * n]);
+			}
+		}
+
+		for (int b = 0; b < block_cnt; b++) {
+			error += m_block_losses[b];
+			const double* grads = &m_block_grads[(size_t)b * n];
+			for (int i = 0; i < n; i++) m_params.gradients[i] += grads[i];
+		}
+		return error;
+	}
+
 	//x[0]:, x[1]:dr, x[2]:dg, x[3]:db, x[4]: da,x[5]:r0, x[6]:g0, x[7]:b0, x[8]:a0
 	ObjectParams CalculateLayerObjectParameters() {
 		int obj_n = m_obj_lid_map.size();
@@ -97,12 +149,16 @@ public:
 				lb[9 * oid + 8] = 0.99, ub[9 * oid + 8] = 1.00;
 			}
 		}
-		double f_min, tol = 1e-5;
+		for (auto it = m_init_vars.begin(); it != m_init_vars.end(); it++) {
+			for (int j = 9 * it->first; j < 9 * (it->first + 1); j++)
+				x[j] = min(ub[j], max(lb[j], it->second[j - 9 * it->first]));
+		}
+		double f_min, tol = m_xtol;
 		nlopt_opt opter = nlopt_create(NLOPT_LD_LBFGS, n);
 		nlopt_set_lower_bounds(opter, lb);
 		nlopt_set_upper_bounds(opter, ub);
 		nlopt_set_min_objective(opter, global_loss_function, this);
-		nlopt_set_maxeval(opter, 1000);
+		nlopt_set_maxeval(opter, m_max_eval);
 		nlopt_set_xtol_rel(opter, tol);
 
 		nlopt_result result = nlopt_optimize(opter, x, &f_min);
@@ -168,14 +224,12 @@ dual E_gamut(Vec2d& pos, vector<int>& oids, ObjectParams& params, double w_g, in
 
 double global_loss_function(unsigned n, const double* x, double* grad, void* data) {
 	LayerParameterOptimization* pLPO = (LayerParameterOptimization*)data;
+	pLPO->m_eval_cnt++;
 	double error = 0;
 	if (grad) {
-		for (int i = 0; i < n; i++) {
-			pLPO->m_params.gradients[i] = 0;
+		for (int i = 0; i < n; i++)
 			pLPO->m_params.vars[i] = x[i];
-		}
-		for (int i = 0; i < pLPO->m_pix_covered_objects.size(); i++)
-			error += pLPO->CalculateLossAndGradientOfPix(i);
+		error = pLPO->CalculateLossAndGradient();
 
 		for (int i = 0; i < n; i++)
 			grad[i] = pLPO->m_params.gradients[i];
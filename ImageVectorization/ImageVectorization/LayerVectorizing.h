@@ -8,14 +8,27 @@
 #include "Graph.h"
 #include "LayerParameterOptimization.h"
 #include "Object.h"
+#include "BoundaryGraph.h"
+#include "SvgEmitter.h"
+#include "OutputWriters.h"
 
 using namespace std;
 using namespace cv;
 
+//a configuration as kept while the configurations are optimized: the layer structure with the fitted params and
+//the losses, a few KB; the pixels are not part of it, they stay in the regions of the case
+struct LayerCandidate {
+	vector<vector<Object>> layer_objects;
+	double total_loss = 1e8;
+	double recon_gamut_loss = 0;
+	double ave_region_layer_cnt = 0;
+	double big_over_small_cnt = 0;
+};
+
 class LayerVectorizing {
 private:
 	ImageObj* m_input_img;
-	vector<Region> m_regions;
+	const vector<Region>* m_regions;		//owned by the case, shared by all configurations
 	vector<vector<Object>> m_layer_objects; //a layer may contain several objects
 	vector<Mat> m_layer_imgs;				//store each layer's objects
 	Mat m_reconstructed_img;
@@ -31,6 +44,17 @@ public:
 	double m_wg = 10.0;
 	double m_wc = 0.02;
 
+	int m_sample_n = 30;		//sampled pixels per region
+	int m_max_eval = 1000;		//L-BFGS evaluations
+	double m_xtol = 1e-5;
+	bool m_parallel_loss = false;	//spread each loss evaluation over the cores, see LayerParameterOptimization::m_parallel
+	const vector<vector<double>>* m_init_region_vars = nullptr;	//warm start: 9 optimizer vars by region id, empty for the default
+	vector<vector<double>> m_region_vars;	//after the optimization: the optimizer vars of each region's topmost object
+
+	// for instrumentation
+	int m_sample_cnt = 0;		//pixels sampled for the optimization
+	int m_eval_cnt = 0;			//L-BFGS objective evaluations
+
 	// for eva
 	double m_data_loss = 0;
 	double m_gamut_loss = 0;
@@ -39,12 +63,41 @@ public:
 public:
 	LayerVectorizing() {}
 
-	LayerVectorizing(vector<Region> regions, ImageObj* input_img, vector<vector<Object>> layer_objs) {
+	LayerVectorizing(const vector<Region>* regions, ImageObj* input_img, vector<vector<Object>> layer_objs) {
 		m_regions = regions;
 		m_input_img = input_img;
 		m_layer_objects = layer_objs;
 	}
 
+	//the full form of a candidate, whose images and masks are rendered from the regions on output
+	LayerVectorizing(const vector<Region>* regions, ImageObj* input_img, LayerCandidate&& cand) {
+		m_regions = regions;
+		m_input_img = input_img;
+		m_layer_objects = move(cand.layer_objects);
+		m_layer_cnt = m_layer_objects.size() - 1;
+		m_total_loss = cand.total_loss;
+		m_recon_gamut_loss = cand.recon_gamut_loss;
+		m_ave_region_layer_cnt = cand.ave_region_layer_cnt;
+		m_big_over_small_cnt = cand.big_over_small_cnt;
+	}
+
+	//the compact form, once the loss is calculated; the layer objects are moved out
+	LayerCandidate TakeCandidate() {
+		LayerCandidate cand;
+		cand.layer_objects = move(m_layer_objects);
+		cand.total_loss = m_total_loss;
+		cand.recon_gamut_loss = m_recon_gamut_loss;
+		cand.ave_region_layer_cnt = m_ave_region_layer_cnt;
+		cand.big_over_small_cnt = m_big_over_small_cnt;
+		return cand;
+	}
+
+	//drop the rendered images once they are written
+	void ReleaseImages() {
+		vector<Mat>().swap(m_layer_imgs);
+		m_reconstructed_img = Mat();
+	}
+
 	bool operator < (LayerVectorizing& Ld) {
 		return m_total_loss < Ld.m_total_loss;
 	}
@@ -64,23 +117,21 @@ public:
 		return Vec2i(-1, -1);
 	}
 
-	vector<int> SamplePixelsInAllRegions() {
+	//sample_rids: the region of each sampled pixel
+	vector<int> SamplePixelsInAllRegions(vector<int>& sample_rids) {
 		vector<int> sample_pids;
+		sample_rids.clear();
 
 		//region 0 is the canvas, no need to sample
-		for (int i = 1; i < m_regions.size(); i++) {
-			int k = m_regions[i].m_region_pids.size();
-			int sample_n = 30;
-			double step = k * 1.0 / sample_n;
-			for (double j = 0; j < k; j += step) {
-				int pid = m_regions[i].m_region_pids[int(j)];
-				sample_pids.push_back(pid);
-			}
+		for (int i = 1; i < m_regions->size(); i++) {
+			(*m_regions)[i].SamplePixels(m_sample_n, m_input_img->w, sample_pids);
+			sample_rids.resize(sample_pids.size(), i);
 		}
 		return sample_pids;
 	}
 
-	vector<PixPassedObjects> GetPixelPassedObjectsFromBottom2Top(vector<int>& pixels) {
+	//an object covers a pixel when it covers the pixel's region, pixel_rids
+	vector<PixPassedObjects> GetPixelPassedObjectsFromBottom2Top(vector<int>& pixels, vector<int>& pixel_rids) {
 		vector<PixPassedObjects> pix_passed_objs(pixels.size());
 		for (int i = 0; i < pixels.size(); i++) {
 			int pid = pixels[i];
@@ -90,7 +141,7 @@ public:
 
 			for (int j = 0; j < m_layer_objects.size(); j++) {
 				for (Object& obj : m_layer_objects[j]) {
-					if (find(obj.covered_pids.begin(), obj.covered_pids.end(), pid) != obj.covered_pids.end()) {
+					if (obj.covered_rids.count(pixel_rids[i])) {
 						ppo.covered_objects.push_back(obj.obj_id);
 						break;
 					}
@@ -111,20 +162,38 @@ public:
 				obj.obj_id = k++;
 
 				obj_layer_map[obj.obj_id] = i;
-
-				for (auto it = obj.covered_rids.begin(); it != obj.covered_rids.end(); it++) {
-					Region& R = m_regions[*it];
-					obj.covered_pids.insert(obj.covered_pids.end(), R.m_region_pids.begin(), R.m_region_pids.end());
-				}
 			}
 		}
 
-		vector<int> sample_pids = SamplePixelsInAllRegions();
-		vector<PixPassedObjects> pix_passed_objs = GetPixelPassedObjectsFromBottom2Top(sample_pids);
-
-		LayerParameterOptimization LPO(m_input_img->colors, pix_passed_objs, m_layer_objects.size(), obj_layer_map, m_wr, m_wg);
+		vector<int> sample_rids;
+		vector<int> sample_pids = SamplePixelsInAllRegions(sample_rids);
+		vector<PixPassedObjects> pix_passed_objs = GetPixelPassedObjectsFromBottom2Top(sample_pids, sample_rids);
+
+		//the topmost object of a region is the region's own shape, it is warm started from the region's vars
+		vector<int> top_oid(m_regions->size(), -1);
+		for (int i = 1; i < m_layer_objects.size(); i++)
+			for (Object& obj : m_layer_objects[i])
+				for (int rid : obj.covered_rids) top_oid[rid] = obj.obj_id;
+
+		LayerParameterOptimization LPO(*m_input_img, pix_passed_objs, m_layer_objects.size(), obj_layer_map, m_wr, m_wg, m_max_eval, m_xtol);
+		LPO.m_parallel = m_parallel_loss;
+		if (m_init_region_vars) {
+			for (int rid = 0; rid < m_init_region_vars->size() && rid < top_oid.size(); rid++)
+				if (top_oid[rid] >= 0 && (*m_init_region_vars)[rid].size() == 9 && !LPO.m_init_vars.count(top_oid[rid]))
+					LPO.m_init_vars[top_oid[rid]] = (*m_init_region_vars)[rid];
+		}
 		ObjectParams obj_params = LPO.CalculateLayerObjectParameters();
 		m_recon_gamut_loss = LPO.m_recon_gamut_loss;
+		m_layer_cnt = m_layer_objects.size() - 1;	//layer 0 is the canvas
+		m_sample_cnt = sample_pids.size();
+		m_eval_cnt = LPO.m_eval_cnt;
+
+		m_region_vars.assign(m_regions->size(), vector<double>());
+		for (int rid = 0; rid < top_oid.size(); rid++) {
+			if (top_oid[rid] < 0) continue;
+			for (int j = 9 * top_oid[rid]; j < 9 * (top_oid[rid] + 1); j++)
+				m_region_vars[rid].push_back((double)obj_params.vars[j]);
+		}
 
 		vector<MatrixXd> result_params = obj_params.Convert2Mats();
 		for (int i = 1; i < m_layer_objects.size(); i++) {
@@ -138,19 +207,25 @@ public:
 	void CalculateTotalLoss(string error_path = "", int id = 0) {
 		//1. average region covering layers
 		double region_cover_cnt = 0;
-		for (int i = 1; i < m_regions.size(); i++) {
+		for (int i = 1; i < m_regions->size(); i++) {
 			for (int j = 0; j < m_layer_objects.size(); j++) {
 				Vec2i pos = FindObjContainsRegion(i, j);
 				if (pos[0] != -1) region_cover_cnt++;
 			}
 		}
-		m_ave_region_layer_cnt = region_cover_cnt / (m_regions.size() - 1);
+		m_ave_region_layer_cnt = region_cover_cnt / (m_regions->size() - 1);
 
-		//2. bigger layer over smaller layer
+		//2. bigger layer over smaller layer, the size of an object is the pixel cnt of its regions (none for the canvas)
 		vector<Object> all_objects;
+		vector<int> pixel_cnts;
 		for (int i = 0; i < m_layer_objects.size(); i++) {
-			for (int j = 0; j < m_layer_objects[i].size(); j++)
+			for (int j = 0; j < m_layer_objects[i].size(); j++) {
 				all_objects.push_back(m_layer_objects[i][j]);
+				int cnt = 0;
+				if (i > 0)
+					for (int rid : m_layer_objects[i][j].covered_rids) cnt += (*m_regions)[rid].PixelCnt();
+				pixel_cnts.push_back(cnt);
+			}
 		}
 
 		m_big_over_small_cnt = 0;
@@ -158,7 +233,7 @@ public:
 			Object& obj_1 = all_objects[i];
 			for (int j = i + 1; j < all_objects.size(); j++) {
 				Object& obj_2 = all_objects[j];
-				if (obj_1.covered_pids.size() < obj_2.covered_pids.size())
+				if (pixel_cnts[i] < pixel_cnts[j])
 					m_big_over_small_cnt += obj_1.IsOverlapWith(obj_2);
 			}
 		}
@@ -168,166 +243,291 @@ public:
 	}
 
 	//============================================================================================================================
+	//blend the linear gradient param of an object over the pixels [col_begin, col_end) of row, row_pix the
+	//colors of the row; x and the row terms are fixed along the run, so the loop over the columns is flat
+	void BlendObjectRun(const MatrixXd& param, int row, int col_begin, int col_end, Vec3b* row_pix) const {
+		double x = row * 1.0 / (m_input_img->h - 1);
+		int w1 = m_input_img->w - 1;
+		double xa = x * param(0, 3), ya = param(1, 3), a0 = param(2, 3);
+		double xc[3], yc[3], c0[3];
+		for (int k = 0; k < 3; k++) xc[k] = x * param(0, k), yc[k] = param(1, k), c0[k] = param(2, k);
+
+		for (int c = col_begin; c < col_end; c++) {
+			double y = c * 1.0 / w1;
+			double alpha = xa + y * ya + a0;
+			Vec3b& bgr = row_pix[c];
+			for (int k = 0; k < 3; k++) {
+				double top = xc[k] + y * yc[k] + c0[k];
+				double blend = alpha * top + (1 - alpha) * bgr[2 - k] / 255.0;
+				bgr[2 - k] = clamp(blend, 0.0, 1.0) * 255;
+			}
+		}
+	}
+
+	//every layer over the chessboard; layers are independent, so they are rendered in parallel
 	void GenerateResultingLayers() {
 		cv::Mat chessboard = GetChessboard(m_input_img->h, m_input_img->w);
+		int w = m_input_img->w;
 		m_layer_imgs.clear();
 		m_layer_imgs.resize(m_layer_objects.size());
 
-		//cout << "\nLinear gradient parameters======================================" << endl;
-		for (int i = 1; i < m_layer_objects.size(); i++) {
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 1; i < (int)m_layer_objects.size(); i++) {
 			cv::Mat layer_img = chessboard.clone();
-			vector<Object>& objs = m_layer_objects[i];
-
-			//cout << "Layer " << i << "==========================" << endl;
-			for (int j = 0; j < objs.size(); j++) {
-				MatrixXd layer_param = objs[j].param;
-				//cout << "Object " << j + 1<< "'s param:" << endl;
-				//cout << layer_param << endl;
-
-				for (auto it = objs[j].covered_rids.begin(); it != objs[j].covered_rids.end(); it++) {
-					vector<int> pids = m_regions[*it].m_region_pids;
-					//#pragma omp parallel for
-					for (int k = 0; k < pids.size(); k++) {
-						int pid = pids[k];
-						int r = pid / m_input_img->w;
-						int c = pid % m_input_img->w;
-						double x = pid / m_input_img->w * 1.0 / (m_input_img->h - 1);
-						double y = pid % m_input_img->w * 1.0 / (m_input_img->w - 1);
-						MatrixXd pix_pos_mat(1, 3); pix_pos_mat << x, y, 1;
-
-						double pix_alpha = (pix_pos_mat * layer_param.col(3))(0, 0);
-						MatrixXd top_color = pix_pos_mat * layer_param.leftCols(3);
-						MatrixXd bot_color = MatrixXd::Ones(1, 3);
-						Vec3b cv_bot_color = chessboard.at<Vec3b>(r, c);
-						bot_color << cv_bot_color[0] / 255.0, cv_bot_color[1] / 255.0, cv_bot_color[2] / 255.0;
-						MatrixXd result_color = pix_alpha * top_color + (1 - pix_alpha) * bot_color;
-
-
-						layer_img.at<cv::Vec3b>(r, c)[2] = clamp(result_color(0, 0), 0.0, 1.0) * 255;
-						layer_img.at<cv::Vec3b>(r, c)[1] = clamp(result_color(0, 1), 0.0, 1.0) * 255;
-						layer_img.at<cv::Vec3b>(r, c)[0] = clamp(result_color(0, 2), 0.0, 1.0) * 255;
-					}
-				}
-			}
+			Vec3b* pix = layer_img.ptr<Vec3b>();
+			for (const Object& obj : m_layer_objects[i])
+				for (int rid : obj.covered_rids)
+					for (const RegionRun& run : (*m_regions)[rid].m_runs)
+						BlendObjectRun(obj.param, run.row, run.col_begin, run.col_end, pix + (size_t)run.row * w);
 			m_layer_imgs[i] = layer_img;
 		}
 	}
 
+	//layers are blended bottom to top; the runs of one object are distinct, so each object runs in parallel
 	cv::Mat ReconstructImageWithLayers() {
+		if (m_input_img->storage == IMG_STORAGE_TILED)
+			return ReconstructImageByTiles();
 		cv::Mat recon_img(m_input_img->h, m_input_img->w, CV_8UC3, Scalar(255, 255, 255));
+		Vec3b* pix = recon_img.ptr<Vec3b>();
+		int w = m_input_img->w;
+		vector<const RegionRun*> runs;
 		for (int i = 1; i < m_layer_objects.size(); i++) {
-			for (int j = 0; j < m_layer_objects[i].size(); j++) {
-				Object obj = m_layer_objects[i][j];
-				vector<int> obj_pids = obj.covered_pids;
-				MatrixXd obj_param = obj.param;
-				//#pragma omp parallel for
-				for (int k = 0; k < obj.covered_pids.size(); k++) {
-					int pid = obj.covered_pids[k];
-					int r = pid / m_input_img->w;
-					int c = pid % m_input_img->w;
-					double x = pid / m_input_img->w * 1.0 / (m_input_img->h - 1);
-					double y = pid % m_input_img->w * 1.0 / (m_input_img->w - 1);
-					MatrixXd pix_pos_mat(1, 3); pix_pos_mat << x, y, 1;
-
-					MatrixXd bottom_color = MatrixXd::Ones(1, 3);
-					bottom_color << recon_img.at<cv::Vec3b>(r, c)[2] / 255.0,
-						recon_img.at<cv::Vec3b>(r, c)[1] / 255.0,
-						recon_img.at<cv::Vec3b>(r, c)[0] / 255.0;
-					double  pix_alpha = (pix_pos_mat * obj_param.col(3))(0, 0);
-					MatrixXd pix_color = pix_pos_mat * obj_param.leftCols(3);
-					MatrixXd blend_color = pix_alpha * pix_color + (1 - pix_alpha) * bottom_color;
-
-					recon_img.at<cv::Vec3b>(r, c)[2] = clamp(blend_color(0, 0), 0.0, 1.0) * 255;
-					recon_img.at<cv::Vec3b>(r, c)[1] = clamp(blend_color(0, 1), 0.0, 1.0) * 255;
-					recon_img.at<cv::Vec3b>(r, c)[0] = clamp(blend_color(0, 2), 0.0, 1.0) * 255;
+			for (const Object& obj : m_layer_objects[i]) {
+				runs.clear();
+				for (int rid : obj.covered_rids)
+					for (const RegionRun& run : (*m_regions)[rid].m_runs) runs.push_back(&run);
+#pragma omp parallel for
+				for (int k = 0; k < (int)runs.size(); k++)
+					BlendObjectRun(obj.param, runs[k]->row, runs[k]->col_begin, runs[k]->col_end, pix + (size_t)runs[k]->row * w);
+			}
+		}
+		return recon_img;
+	}
+
+	//tiled mode: the tiles are reconstructed independently and in parallel, each from the runs the
+	//regions have in it (see Region::GroupPixelsByTile); a region's pixels get the objects covering it
+	//blended bottom to top, which is the same order as layer by layer
+	cv::Mat ReconstructImageByTiles() {
+		cv::Mat recon_img(m_input_img->h, m_input_img->w, CV_8UC3, Scalar(255, 255, 255));
+		Vec3b* pix = recon_img.ptr<Vec3b>();
+		int w = m_input_img->w;
+
+		vector<vector<const Object*>> region_objs(m_regions->size());
+		for (int i = 1; i < m_layer_objects.size(); i++)
+			for (const Object& obj : m_layer_objects[i])
+				for (int rid : obj.covered_rids)
+					region_objs[rid].push_back(&obj);
+
+		vector<vector<int>> tile_rids(m_input_img->tiles->TileCnt());
+		for (int rid = 1; rid < m_regions->size(); rid++)
+			if (!region_objs[rid].empty())
+				for (const Vec2i& start : (*m_regions)[rid].m_tile_starts)
+					tile_rids[start[0]].push_back(rid);
+
+#pragma omp parallel for schedule(dynamic)
+		for (int t = 0; t < (int)tile_rids.size(); t++) {
+			for (int rid : tile_rids[t]) {
+				const Region& R = (*m_regions)[rid];
+				Vec2i range = R.TileRunRange(t);
+				for (int k = range[0]; k < range[1]; k++) {
+					const RegionRun& run = R.m_runs[k];
+					for (const Object* obj : region_objs[rid])
+						BlendObjectRun(obj->param, run.row, run.col_begin, run.col_end, pix + (size_t)run.row * w);
 				}
 			}
 		}
 		return recon_img;
 	}
 
-	void SaveReconstructedImageAndLayers(string layer_path) {
+	//the reconstruction and the layers side by side; writer: encode and write on its threads
+	void SaveReconstructedImageAndLayers(string layer_path, AsyncImageWriter* writer = nullptr) {
 		int pos = layer_path.rfind('/');
 		string parent_dir = layer_path.substr(0, pos);
-		string grand_dir = parent_dir.substr(0, parent_dir.rfind('/'));
-		if (_access(grand_dir.c_str(), 0) == -1)  int ret = _mkdir(grand_dir.c_str());
-		if (_access(parent_dir.c_str(), 0) == -1) int ret = _mkdir(parent_dir.c_str());
-		string str_id = layer_path.substr(pos + 1, layer_path.size());
+		CreateDirectories(parent_dir);
 
-		m_reconstructed_img = ReconstructImageWithLayers();
+		if (m_reconstructed_img.empty())
+			m_reconstructed_img = ReconstructImageWithLayers();
 
 		Mat result;
 		m_layer_imgs[0] = m_reconstructed_img;
 		hconcat(m_layer_imgs, result);
-		cv::imwrite(layer_path + ".png", result);
+		WriteImage(writer, layer_path + ".png", result);
 	}
 
-	void OutputLayerMask(string layer_mask_path) {
+	//the layers as 4-channel PNGs, layer_<i>.png, transparent outside the objects and with straight or
+	//premultiplied alpha, plus reconstruction.png; nothing is composited over the chessboard
+	void OutputRgbaLayers(string layer_dir, bool premultiplied, AsyncImageWriter* writer = nullptr) {
+		CreateDirectories(layer_dir);
+		if (m_reconstructed_img.empty())
+			m_reconstructed_img = ReconstructImageWithLayers();
+		WriteImage(writer, layer_dir + "/reconstruction.png", m_reconstructed_img);
+
+		int w = m_input_img->w, h = m_input_img->h;
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 1; i < (int)m_layer_objects.size(); i++) {
+			cv::Mat layer_img(h, w, CV_8UC4, Scalar(0, 0, 0, 0));
+			Vec4b* pix = layer_img.ptr<Vec4b>();
+			for (const Object& obj : m_layer_objects[i]) {
+				const MatrixXd& param = obj.param;
+				for (int rid : obj.covered_rids) {
+					for (const RegionRun& run : (*m_regions)[rid].m_runs) {
+						double x = run.row * 1.0 / (h - 1);
+						Vec4b* row_pix = pix + (size_t)run.row * w;
+						for (int c = run.col_begin; c < run.col_end; c++) {
+							double y = c * 1.0 / (w - 1);
+							double alpha = clamp(x * param(0, 3) + y * param(1, 3) + param(2, 3), 0.0, 1.0);
+							for (int k = 0; k < 3; k++) {
+								double color = clamp(x * param(0, k) + y * param(1, k) + param(2, k), 0.0, 1.0);
+								row_pix[c][2 - k] = (premultiplied ? color * alpha : color) * 255;
+							}
+							row_pix[c][3] = alpha * 255;
+						}
+					}
+				}
+			}
+			WriteImage(writer, layer_dir + "/layer_" + to_string(i) + ".png", layer_img);
+		}
+	}
+
+	//one single-channel 1-bit PNG per object, mask_<layer>_<index>.png, white on the object;
+	//the masks are filled in parallel and encoded by the writer when given
+	void OutputLayerMask(string layer_mask_path, AsyncImageWriter* writer = nullptr) {
 		int pos = layer_mask_path.rfind('/');
 		string parent_dir = layer_mask_path.substr(0, pos);
-		if (_access(parent_dir.c_str(), 0) == -1) int ret = _mkdir(parent_dir.c_str());
+		CreateDirectories(parent_dir);
 
+		vector<Vec2i> objs;
+		for (int i = 1; i < m_layer_objects.size(); i++)
+			for (int j = 0; j < m_layer_objects[i].size(); j++)
+				objs.push_back(Vec2i(i, j));
+
+		vector<int> params = { IMWRITE_PNG_BILEVEL, 1 };
+#pragma omp parallel for schedule(dynamic)
+		for (int k = 0; k < (int)objs.size(); k++) {
+			int i = objs[k][0], j = objs[k][1];
+			cv::Mat layer_mask(m_input_img->h, m_input_img->w, CV_8UC1, Scalar(0));
+			for (int rid : m_layer_objects[i][j].covered_rids)
+				(*m_regions)[rid].Rasterize(layer_mask.data, m_input_img->w, (uchar)255);
+			WriteImage(writer, layer_mask_path + "/mask_" + to_string(i) + "_" + to_string(j + 1) + ".png", layer_mask, params);
+		}
+	}
+
+	//all object masks in one file of row runs, see WritePackedMasks
+	bool OutputPackedLayerMasks(string path) {
+		int pos = path.rfind('/');
+		if (pos != string::npos) CreateDirectories(path.substr(0, pos));
+
+		int w = m_input_img->w;
+		vector<PackedMask> masks;
 		for (int i = 1; i < m_layer_objects.size(); i++) {
-			vector<Object>& objs = m_layer_objects[i];
-			for (int j = 0; j < objs.size(); j++) {
-				cv::Mat layer_mask(m_input_img->h, m_input_img->w, CV_8UC3, Scalar(0, 0, 0));
-
-				for (auto it = objs[j].covered_rids.begin(); it != objs[j].covered_rids.end(); it++) {
-					vector<int> pids = m_regions[*it].m_region_pids;
-					//#pragma omp parallel for
-					for (int k = 0; k < pids.size(); k++) {
-						int pid = pids[k];
-						int r = pid / m_input_img->w;
-						int c = pid % m_input_img->w;
-						layer_mask.at<cv::Vec3b>(r, c)[2] = 255;
-						layer_mask.at<cv::Vec3b>(r, c)[1] = 255;
-						layer_mask.at<cv::Vec3b>(r, c)[0] = 255;
-					}
-				}
-				string path = layer_mask_path + "/mask_" + to_string(i) + "_" + to_string(j + 1) + ".png";
-				imwrite(path, layer_mask);
+			for (int j = 0; j < m_layer_objects[i].size(); j++) {
+				PackedMask m;
+				m.layer = i, m.index = j + 1;
+				for (int rid : m_layer_objects[i][j].covered_rids)
+					for (const RegionRun& run : (*m_regions)[rid].m_runs)
+						m.runs.push_back(Vec3i(run.row, run.col_begin, run.col_end));
+				MergeRuns(m.runs);
+				m.bbox = Vec4i(m_input_img->h, w, -1, -1);
+				for (const Vec3i& run : m.runs)
+					m.bbox = Vec4i(min(m.bbox[0], run[0]), min(m.bbox[1], run[1]), max(m.bbox[2], run[0]), max(m.bbox[3], run[2] - 1));
+				masks.push_back(m);
 			}
 		}
+		return WritePackedMasks(path, m_input_img->h, w, masks);
+	}
+
+	//boundary graph of the region label map with fitted chains; it only depends on the regions, so one
+	//graph serves all configurations of a case
+	BoundaryGraph BuildBoundaryGraph(double fit_tolerance = 0.5) const {
+		int h = m_input_img->h, w = m_input_img->w;
+		vector<int> labels((size_t)h * w, 0);
+		for (int i = 1; i < m_regions->size(); i++)
+			(*m_regions)[i].Rasterize(labels.data(), w, i);
+
+		BoundaryGraph graph;
+		graph.Build(labels.data(), h, w, max((int)m_regions->size(), 1));
+		graph.FitChains(fit_tolerance);
+		return graph;
+	}
+
+	//Vector graph of the layers in place of Gen_svg_script/main.py and potrace: the outline of every object is traced
+	//from the region label map and fitted with Bezier curves, fit_tolerance in pixels; objects run in parallel.
+	bool OutputSvg(string svg_path, double fit_tolerance = 0.5) {
+		return OutputSvg(svg_path, BuildBoundaryGraph(fit_tolerance));
+	}
+
+	bool OutputSvg(string svg_path, const BoundaryGraph& graph) {
+		int h = m_input_img->h, w = m_input_img->w;
+		int pos = svg_path.rfind('/');
+		if (pos != string::npos) CreateDirectories(svg_path.substr(0, pos));
+
+		//1. gradient and outline of every object, the outline assembled from the fitted chains====
+		vector<Vec2i> objs;
+		for (int i = 1; i < m_layer_objects.size(); i++)
+			for (int j = 0; j < m_layer_objects[i].size(); j++)
+				objs.push_back(Vec2i(i, j));
+		vector<string> gradient_tags(objs.size()), path_tags(objs.size());
+
+#pragma omp parallel for schedule(dynamic)
+		for (int k = 0; k < (int)objs.size(); k++) {
+			int i = objs[k][0], j = objs[k][1];
+			Object& obj = m_layer_objects[i][j];
+			string name = to_string(i) + "-" + to_string(j + 1);
+
+			Vec4i bbox(h, w, -1, -1);
+			for (int rid : obj.covered_rids) {
+				Vec4i rb = (*m_regions)[rid].PixelBbox();
+				bbox = Vec4i(min(bbox[0], rb[0]), min(bbox[1], rb[1]), max(bbox[2], rb[2]), max(bbox[3], rb[3]));
+			}
+			if (bbox[2] < 0) continue;
+
+			vector<uint8_t> in_obj(m_regions->size(), 0);
+			for (int rid : obj.covered_rids) in_obj[rid] = 1;
+			string path_data = BezierLoopsToPathData(graph.Outline(in_obj, obj.covered_rids));
+			if (IsFlatFill(obj.param)) {
+				path_tags[k] = FlatFillPathTag(path_data, "region-" + name, obj.param);
+				continue;
+			}
+			gradient_tags[k] = LinearGradientTag(obj.param, bbox, h, w, "linear-gradient-" + name);
+			path_tags[k] = SvgPathTag(path_data, "region-" + name, "linear-gradient-" + name);
+		}
+
+		//2. layers bottom to top====
+		vector<vector<string>> layer_paths(m_layer_objects.size() - 1);
+		for (int k = 0; k < objs.size(); k++)
+			if (!path_tags[k].empty()) layer_paths[objs[k][0] - 1].push_back(path_tags[k]);
+		return WriteSvgDocument(svg_path, h, w, gradient_tags, layer_paths);
 	}
 
 	void OutputJsonForPresentation(string json_path) {
 		int pos = json_path.rfind('/');
 		string parent_dir = json_path.substr(0, pos);
-		int pos1 = parent_dir.rfind('/');
-		string parent_parent_dir = parent_dir.substr(0, pos1);
-		if (_access(parent_parent_dir.c_str(), 0) == -1) int ret = _mkdir(parent_parent_dir.c_str());
-		if (_access(parent_dir.c_str(), 0) == -1) int ret = _mkdir(parent_dir.c_str());
-
-		ofstream of(json_path);
-		of << "{" << endl;
-		of << "\t\"width\": " << m_input_img->w << "," << endl;
-		of << "\t\"height\": " << m_input_img->h << "," << endl;
-		of << "\t\"linearGradients\": [" << endl;
-
+		CreateDirectories(parent_dir);
+
+		//"linearGradients": one entry per layer, holding the 4 x 3 parameter matrix (rows r, g, b, a) of each object
+		BufferedFileWriter out;
+		JsonWriter json(out);
+		json.BeginObject();
+		json.Key("width"), json.Value(m_input_img->w);
+		json.Key("height"), json.Value(m_input_img->h);
+		json.Key("linearGradients"), json.BeginArray();
 		for (int i = 1; i < m_layer_objects.size(); i++) {
-			of << "\t\t{" << endl;
+			json.BeginObject();
 			for (int j = 0; j < m_layer_objects[i].size(); j++) {
-				Object& obj = m_layer_objects[i][j];
-				MatrixXd mat = obj.param.transpose();
-
-				of << "\t\t\"#" << to_string(i) + "-" + to_string(j + 1) + "\": [" << endl;
-				of << "\t\t\t\t\t[" << mat(0, 0) << "," << mat(0, 1) << "," << mat(0, 2) << "]," << endl;
-				of << "\t\t\t\t\t[" << mat(1, 0) << "," << mat(1, 1) << "," << mat(1, 2) << "]," << endl;
-				of << "\t\t\t\t\t[" << mat(2, 0) << "," << mat(2, 1) << "," << mat(2, 2) << "]," << endl;
-				of << "\t\t\t\t\t[" << mat(3, 0) << "," << mat(3, 1) << "," << mat(3, 2) << "]" << endl;
-
-				if (j != m_layer_objects[i].size() - 1)
-					of << "\t\t\t\t]," << endl;
-				else
-					of << "\t\t\t\t]" << endl;
+				MatrixXd mat = m_layer_objects[i][j].param.transpose();
+				json.Key("#" + to_string(i) + "-" + to_string(j + 1)), json.BeginArray();
+				for (int r = 0; r < 4; r++) {
+					json.BeginArray(true);
+					for (int c = 0; c < 3; c++) json.Value(mat(r, c));
+					json.EndArray();
+				}
+				json.EndArray();
 			}
-			if (i != m_layer_objects.size() - 1)
-				of << "\t\t}," << endl;
-			else
-				of << "\t\t}" << endl;
+			json.EndObject();
 		}
-
-		of << "\t]" << endl;
-		of << "}" << endl;
+		json.EndArray();
+		json.EndObject();
+		out << '\n';
+		out.WriteTo(json_path);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "Instrumentation.h"
+
+using namespace std;
+
+//A small harness in the style of Google Benchmark: a benchmark is a function of a BenchmarkState,
+//registered once per argument tuple, which repeats the measured code while state.KeepRunning().
+//The iteration cnt grows until a run lasts at least the minimum time.
+//
+//	static void BM_Foo(BenchmarkState& state) {
+//		Input in = MakeInput(state.Arg(0));
+//		while (state.KeepRunning())
+//			DoNotOptimize(Foo(in));
+//	}
+//	MicroBenchmarkRegistry::Add("Foo", BM_Foo, { { 16 }, { 64 } }, { "n" });
+
+template<typename T>
+inline void DoNotOptimize(T const& value) {
+#if defined(_MSC_VER)
+	static volatile const void* sink;
+	sink = &value;
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+class BenchmarkState {
+private:
+	vector<long long>	m_args;
+	long long			m_max_iterations;
+	long long			m_iterations = 0;
+	bool				m_started = false, m_paused = false;
+	double				m_wall0 = 0, m_cpu0 = 0;
+	double				m_wall = 0, m_cpu = 0;		//accumulated time while not paused
+
+public:
+	map<string, double>	counters;					//reported as set, e.g. trees found by one enumeration
+	long long			items_processed = 0;		//reported as items/s when set
+
+public:
+	BenchmarkState(const vector<long long>& args, long long max_iterations) : m_args(args), m_max_iterations(max_iterations) {}
+
+	long long Arg(int i) const { return m_args[i]; }
+	long long Iterations() const { return m_iterations; }
+	double WallTime() const { return m_wall; }
+	double CpuTime() const { return m_cpu; }
+
+	bool KeepRunning() {
+		if (!m_started) {
+			m_started = true;
+			ResumeTiming();
+		}
+		if (m_iterations < m_max_iterations) {
+			m_iterations++;
+			return true;
+		}
+		PauseTiming();
+		return false;
+	}
+
+	//exclude per iteration setup, e.g. rebuilding an input the measured code consumes
+	void PauseTiming() {
+		if (m_paused) return;
+		m_wall += WallSeconds() - m_wall0;
+		m_cpu += CpuSeconds(true) - m_cpu0;
+		m_paused = true;
+	}
+
+	void ResumeTiming() {
+		m_wall0 = WallSeconds();
+		m_cpu0 = CpuSeconds(true);
+		m_paused = false;
+	}
+};
+
+struct MicroBenchmarkResult {
+	string				name;
+	long long			iterations = 0;
+	double				wall_per_iter = 0, cpu_per_iter = 0;	//seconds
+	double				items_per_second = 0;
+	map<string, double>	counters;
+};
+
+class MicroBenchmarkRegistry {
+private:
+	struct Entry {
+		string							name;
+		function<void(BenchmarkState&)>	fn;
+		vector<long long>				args;
+	};
+
+	static vector<Entry>& Entries() {
+		static vector<Entry> entries;
+		return entries;
+	}
+
+public:
+	//one benchmark per argument tuple, named "name/arg_name:value/..."
+	static void Add(string name, function<void(BenchmarkState&)> fn, vector<vector<long long>> arg_sets = { {} }, vector<string> arg_names = {}) {
+		for (const vector<long long>& args : arg_sets) {
+			string full_name = name;
+			for (int i = 0; i < args.size(); i++)
+				full_name += "/" + (i < arg_names.size() ? arg_names[i] + ":" : "") + to_string(args[i]);
+			Entries().push_back({ full_name, fn, args });
+		}
+	}
+
+	//runs the benchmarks whose name contains filter
+	static vector<MicroBenchmarkResult> RunAll(string filter = "", double min_time = 0.5) {
+		vector<MicroBenchmarkResult> results;
+		cout << left << setw(56) << "benchmark" << right << setw(14) << "wall/iter" << setw(14) << "cpu/iter" << setw(12) << "iterations" << "  counters" << endl;
+		cout << string(110, '-') << endl;
+		for (Entry& e : Entries()) {
+			if (!filter.empty() && e.name.find(filter) == string::npos) continue;
+			MicroBenchmarkResult r = Run(e, min_time);
+			Print(r);
+			results.push_back(r);
+		}
+		return results;
+	}
+
+	static void WriteJson(string path, const vector<MicroBenchmarkResult>& results) {
+		ofstream of(path);
+		of << setprecision(6) << "[\n";
+		for (int i = 0; i < results.size(); i++) {
+			const MicroBenchmarkResult& r = results[i];
+			of << "{\"name\":\"" << JsonEscape(r.name) << "\",\"iterations\":" << r.iterations << ",\"wall_ns\":" << r.wall_per_iter * 1e9
+				<< ",\"cpu_ns\":" << r.cpu_per_iter * 1e9 << ",\"items_per_second\":" << r.items_per_second;
+			for (auto& kv : r.counters)
+				of << ",\"" << JsonEscape(kv.first) << "\":" << kv.second;
+			of << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		of << "]\n";
+	}
+
+private:
+	static MicroBenchmarkResult Run(Entry& e, double min_time) {
+		long long n = 1;
+		while (1) {
+			BenchmarkState state(e.args, n);
+			e.fn(state);
+			double t = state.WallTime();
+			if (t >= min_time || n >= 1000000000LL) {
+				MicroBenchmarkResult r;
+				r.name = e.name;
+				r.iterations = state.Iterations();
+				long long iters = max(1LL, r.iterations);
+				r.wall_per_iter = t / iters;
+				r.cpu_per_iter = state.CpuTime() / iters;
+				r.items_per_second = (state.items_processed && t > 0) ? state.items_processed / t : 0;
+				r.counters = state.counters;
+				return r;
+			}
+			//aim 40% past the minimum time, but grow at most 10x per round
+			double scale = t > 0 ? min_time * 1.4 / t : 10;
+			n = max(n + 1, (long long)(n * min(10.0, max(1.5, scale))));
+		}
+	}
+
+	static string FormatTime(double s) {
+		ostringstream os;
+		os << fixed << setprecision(s < 1e-6 ? 1 : 2);
+		if (s < 1e-6) os << s * 1e9 << " ns";
+		else if (s < 1e-3) os << s * 1e6 << " us";
+		else if (s < 1) os << s * 1e3 << " ms";
+		else os << s << " s";
+		return os.str();
+	}
+
+	static void Print(const MicroBenchmarkResult& r) {
+		cout << left << setw(56) << r.name << right << setw(14) << FormatTime(r.wall_per_iter) << setw(14) << FormatTime(r.cpu_per_iter)
+			<< setw(12) << r.iterations << " ";
+		if (r.items_per_second > 0)
+			cout << " items/s=" << setprecision(4) << r.items_per_second;
+		for (auto& kv : r.counters)
+			cout << " " << kv.first << "=" << setprecision(10) << kv.second;
+		cout << endl;
+	}
+};
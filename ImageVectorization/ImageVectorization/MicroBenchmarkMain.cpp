@@ -0,0 +1,210 @@
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <cstdlib>
+#include "MicroBenchmark.h"
+#include "Graph.h"
+#include "LayerParameterOptimization.h"
+#include "LayerVectorizing.h"
+using namespace std;
+using namespace cv;
+
+//synthetic inputs, all generated from a fixed seed so that runs are comparable====================
+
+//a stack of depth objects covering every sample, object 0 (the bottom) opaque, random colors and parameters
+struct SyntheticOptimizationProblem {
+	ImageObj					img;
+	vector<PixPassedObjects>	samples;
+	map<int, int>				obj_lid_map;
+	vector<double>				x, grad;
+};
+
+static SyntheticOptimizationProblem MakeOptimizationProblem(int depth, int sample_cnt, unsigned seed = 600) {
+	mt19937 rng(seed);
+	uniform_real_distribution<double> unit(0, 1), coef(-1, 1);
+	SyntheticOptimizationProblem p;
+
+	vector<Vec3d> colors(sample_cnt);
+	for (Vec3d& color : colors)
+		color = Vec3d(unit(rng), unit(rng), unit(rng));
+	p.img = ImageObj(colors, 1, sample_cnt, 3);
+
+	vector<int> stack(depth);
+	for (int i = 0; i < depth; i++) {
+		stack[i] = i;
+		p.obj_lid_map[i] = i + 1;
+	}
+	for (int i = 0; i < sample_cnt; i++) {
+		PixPassedObjects ppo(i, Vec2d(unit(rng), unit(rng)));
+		ppo.covered_objects = stack;
+		p.samples.push_back(ppo);
+	}
+
+	//x[0]: theta in [0, 2pi], the others in [-1, 1], as bounded by CalculateLayerObjectParameters
+	p.x.resize(9 * depth);
+	p.grad.resize(9 * depth);
+	for (int i = 0; i < p.x.size(); i++)
+		p.x[i] = i % 9 == 0 ? unit(rng) * 2 * PI : coef(rng);
+	return p;
+}
+
+//regions on a rows x cols grid, region 0 is the canvas and supports the border regions; a region supports
+//its grid neighbors unless it is less than half their size; each interior grid corner where 4 regions meet
+//is an X-junction with probability xj_percent / 100
+struct SyntheticRegionGraph {
+	int						n = 0;
+	vector<Vec2i>			edges;
+	vector<array<int, 4>>	xjunctions;
+};
+
+static SyntheticRegionGraph MakeRegionGraph(int rows, int cols, int xj_percent, unsigned seed = 600) {
+	mt19937 rng(seed);
+	uniform_int_distribution<int> size_dist(50, 200), percent(0, 99);
+	SyntheticRegionGraph g;
+	g.n = rows * cols + 1;
+
+	auto rid = [cols](int r, int c) { return 1 + r * cols + c; };
+	vector<int> sizes(g.n);
+	for (int i = 1; i < g.n; i++)
+		sizes[i] = size_dist(rng);
+
+	for (int r = 0; r < rows; r++) {
+		for (int c = 0; c < cols; c++) {
+			if (r == 0 || c == 0 || r == rows - 1 || c == cols - 1)
+				g.edges.push_back(Vec2i(0, rid(r, c)));
+		}
+	}
+	for (int r = 0; r < rows; r++) {
+		for (int c = 0; c < cols; c++) {
+			int u = rid(r, c);
+			int nbs[2] = { c + 1 < cols ? rid(r, c + 1) : 0, r + 1 < rows ? rid(r + 1, c) : 0 };
+			for (int v : nbs) {
+				if (!v) continue;
+				if (sizes[u] * 2 >= sizes[v]) g.edges.push_back(Vec2i(u, v));
+				if (sizes[v] * 2 >= sizes[u]) g.edges.push_back(Vec2i(v, u));
+			}
+		}
+	}
+	//ring order around the corner, as ScanXjunctions reports them
+	for (int r = 0; r + 1 < rows; r++) {
+		for (int c = 0; c + 1 < cols; c++) {
+			if (percent(rng) < xj_percent)
+				g.xjunctions.push_back({ rid(r, c), rid(r, c + 1), rid(r + 1, c + 1), rid(r + 1, c) });
+		}
+	}
+	return g;
+}
+
+//layer_cnt layers of one object each: the bottom one covers the whole image, the others random rectangles;
+//regions: one rectangle region per object, they must outlive the returned stack
+static LayerVectorizing MakeLayerStack(ImageObj* img, vector<Region>& regions, int layer_cnt, unsigned seed = 600) {
+	mt19937 rng(seed);
+	uniform_real_distribution<double> unit(0, 1), coef(-0.5, 0.5);
+	vector<vector<Object>> layer_objs(layer_cnt + 1);		//layer 0 is the canvas
+	regions.assign(layer_cnt + 1, Region());
+
+	for (int i = 1; i <= layer_cnt; i++) {
+		Object obj(i - 1, i, { i });
+		int r0 = 0, c0 = 0, r1 = img->h, c1 = img->w;
+		if (i > 1) {
+			r0 = unit(rng) * img->h / 2, c0 = unit(rng) * img->w / 2;
+			r1 = r0 + img->h / 4 + unit(rng) * img->h / 4, c1 = c0 + img->w / 4 + unit(rng) * img->w / 4;
+		}
+		regions[i].m_region_id = i;
+		for (int r = r0; r < r1; r++)
+			regions[i].AddRun(r, c0, c1);
+
+		//rows: x, y and constant terms; cols: r, g, b, a
+		obj.param = MatrixXd(3, 4);
+		for (int k = 0; k < 4; k++) {
+			obj.param(0, k) = coef(rng);
+			obj.param(1, k) = coef(rng);
+			obj.param(2, k) = 0.5 + coef(rng) * 0.5;
+		}
+		if (i == 1) obj.param(0, 3) = obj.param(1, 3) = 0, obj.param(2, 3) = 1;
+		layer_objs[i].push_back(obj);
+	}
+	return LayerVectorizing(&regions, img, layer_objs);
+}
+
+//benchmarks===================================================================================
+
+//one objective and gradient evaluation of L-BFGS, the pixel blocks serial or in parallel
+static void BM_GlobalLossFunction(BenchmarkState& state) {
+	int depth = state.Arg(0), sample_cnt = state.Arg(1);
+	SyntheticOptimizationProblem p = MakeOptimizationProblem(depth, sample_cnt);
+	LayerParameterOptimization LPO(p.img, p.samples, depth + 1, p.obj_lid_map);
+	LPO.m_params.Initialize(depth);
+	LPO.m_parallel = state.Arg(2) != 0;
+
+	double loss = 0;
+	while (state.KeepRunning()) {
+		loss = global_loss_function(p.x.size(), p.x.data(), p.grad.data(), &LPO);
+		DoNotOptimize(loss);
+	}
+	state.items_processed = state.Iterations() * sample_cnt;
+	state.counters["loss"] = loss;
+}
+
+//enumeration of the spanning trees, as one round of RegionSupportingTree::GetValidRegionSupportingTrees
+static void BM_EnumTree(BenchmarkState& state) {
+	int rows = state.Arg(0), cols = state.Arg(1), xj_percent = state.Arg(2);
+	SyntheticRegionGraph g = MakeRegionGraph(rows, cols, xj_percent);
+
+	size_t tree_cnt = 0;
+	long long pruned_cnt = 0;
+	while (state.KeepRunning()) {
+		state.PauseTiming();
+		Graph Gx(g.n, g.edges, 4, g.n / 3);
+		Gx.SetXjunctions(g.xjunctions);
+		state.ResumeTiming();
+
+		tree_cnt = Gx.GetAllSpanningTrees().size();
+		pruned_cnt = Gx.pruned_branch_cnt;
+	}
+	state.counters["trees"] = tree_cnt;
+	state.counters["pruned"] = pruned_cnt;
+	state.counters["xjunctions"] = g.xjunctions.size();
+}
+
+static void BM_ReconstructImageWithLayers(BenchmarkState& state) {
+	int size = state.Arg(0), layer_cnt = state.Arg(1);
+	ImageObj img(Mat(size, size, CV_8UC3, Scalar(255, 255, 255)));
+	vector<Region> regions;
+	LayerVectorizing lv = MakeLayerStack(&img, regions, layer_cnt);
+
+	while (state.KeepRunning()) {
+		Mat recon = lv.ReconstructImageWithLayers();
+		DoNotOptimize(recon.data);
+	}
+	state.items_processed = state.Iterations() * size * size;
+}
+
+int main(int argc, char** argv) {
+
+	//MicroBenchmark [--filter <substring>] [--min-time <s>] [--json <file>]
+	string filter, json_path;
+	double min_time = 0.5;
+	for (int i = 1; i + 1 < argc; i += 2) {
+		string arg = argv[i];
+		if (arg == "--filter") filter = argv[i + 1];
+		else if (arg == "--min-time") min_time = atof(argv[i + 1]);
+		else if (arg == "--json") json_path = argv[i + 1];
+		else {
+			cout << "usage: MicroBenchmark [--filter <substring>] [--min-time <s>] [--json <file>]" << endl;
+			return 1;
+		}
+	}
+
+	MicroBenchmarkRegistry::Add("GlobalLossFunction", BM_GlobalLossFunction,
+		{ { 1, 256, 0 }, { 2, 256, 0 }, { 4, 256, 0 }, { 8, 256, 0 }, { 4, 64, 0 }, { 4, 1024, 0 }, { 4, 4096, 0 }, { 4, 4096, 1 } },
+		{ "depth", "samples", "parallel" });
+	MicroBenchmarkRegistry::Add("EnumTree", BM_EnumTree,
+		{ { 2, 2, 0 }, { 2, 3, 0 }, { 3, 3, 0 }, { 3, 4, 0 }, { 3, 3, 50 }, { 3, 3, 100 }, { 3, 4, 50 }, { 3, 4, 100 } }, { "rows", "cols", "xj%" });
+	MicroBenchmarkRegistry::Add("ReconstructImageWithLayers", BM_ReconstructImageWithLayers,
+		{ { 128, 4 }, { 256, 4 }, { 512, 4 }, { 1024, 4 }, { 512, 8 } }, { "size", "layers" });
+
+	vector<MicroBenchmarkResult> results = MicroBenchmarkRegistry::RunAll(filter, min_time);
+	if (!json_path.empty())
+		MicroBenchmarkRegistry::WriteJson(json_path, results);
+	return 0;
+}
@@ -17,7 +17,6 @@ public:
 	Vec4i bbox_coord;
 	MatrixXd param;				// object's linear gradient params 
 	set<int> covered_rids;		// a object may consist of several regions
-	vector<int> covered_pids;
 
 	Object(int id = 0) { obj_id = id; }
 	Object(int oid, int lid, set<int> rids_) { obj_id = oid; layer_id = lid;  covered_rids = rids_; }
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+using namespace cv;
+
+//Result files are built in memory and written with a single call: no flush per line, and one
+//unbuffered fwrite of the whole content instead of a copy through the stream buffer.
+
+class BufferedFileWriter {
+private:
+	string m_buf;
+
+public:
+	BufferedFileWriter(size_t reserve = 1 << 16) { m_buf.reserve(reserve); }
+
+	BufferedFileWriter& operator<<(const string& s) { m_buf += s; return *this; }
+	BufferedFileWriter& operator<<(const char* s) { m_buf += s; return *this; }
+	BufferedFileWriter& operator<<(char ch) { m_buf += ch; return *this; }
+	BufferedFileWriter& operator<<(int v) { m_buf += to_string(v); return *this; }
+	BufferedFileWriter& operator<<(long long v) { m_buf += to_string(v); return *this; }
+
+	//%g with the given significant digits, as an ostream with that precision prints doubles
+	BufferedFileWriter& Put(double v, int precision = 6) {
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), "%.*g", precision, v);
+		m_buf += tmp;
+		return *this;
+	}
+
+	void PutBytes(const void* data, size_t bytes) { m_buf.append((const char*)data, bytes); }
+	template<typename T> void PutPod(const T& v) { PutBytes(&v, sizeof(T)); }
+
+	size_t Size() const { return m_buf.size(); }
+
+	bool WriteTo(const string& path) const {
+		FILE* fp = fopen(path.c_str(), "wb");
+		if (!fp) return false;
+		setvbuf(fp, nullptr, _IONBF, 0);
+		bool ok = fwrite(m_buf.data(), 1, m_buf.size(), fp) == m_buf.size();
+		return fclose(fp) == 0 && ok;
+	}
+};
+
+//JSON written front to back into a BufferedFileWriter; commas and indentation are tracked per level,
+//a container opened with inline_items keeps its items on one line
+class JsonWriter {
+private:
+	BufferedFileWriter&	m_out;
+	vector<int>			m_item_cnt;
+	vector<bool>		m_inline;
+	bool				m_after_key = false;
+
+	void BeginItem() {
+		if (m_after_key) {
+			m_after_key = false;
+			return;
+		}
+		if (m_item_cnt.empty()) return;
+		if (m_item_cnt.back()++) m_out << ',';
+		if (!m_inline.back()) {
+			m_out << '\n';
+			for (int i = 0; i < m_item_cnt.size(); i++) m_out << '\t';
+		}
+	}
+
+	void Open(char ch, bool inline_items) {
+		BeginItem();
+		m_out << ch;
+		m_item_cnt.push_back(0);
+		m_inline.push_back(inline_items || (!m_inline.empty() && m_inline.back()));
+	}
+
+	void Close(char ch) {
+		bool had_items = m_item_cnt.back() > 0, was_inline = m_inline.back();
+		m_item_cnt.pop_back();
+		m_inline.pop_back();
+		if (had_items && !was_inline) {
+			m_out << '\n';
+			for (int i = 0; i < m_item_cnt.size(); i++) m_out << '\t';
+		}
+		m_out << ch;
+	}
+
+public:
+	JsonWriter(BufferedFileWriter& out) : m_out(out) {}
+
+	void BeginObject(bool inline_items = false) { Open('{', inline_items); }
+	void EndObject() { Close('}'); }
+	void BeginArray(bool inline_items = false) { Open('[', inline_items); }
+	void EndArray() { Close(']'); }
+
+	void Key(const string& key) {
+		BeginItem();
+		m_out << '"' << key << "\": ";
+		m_after_key = true;
+	}
+
+	//nan and inf have no JSON form, they are written as null
+	void Value(double v, int precision = 6) {
+		BeginItem();
+		if (isfinite(v)) m_out.Put(v, precision);
+		else m_out << "null";
+	}
+	void Value(int v) { BeginItem(); m_out << v; }
+	void Value(const string& v) { BeginItem(); m_out << '"' << v << '"'; }
+};
+
+//All object masks of a result in one file, as row runs:
+//	char[4] "IVMK", int32 version, height, width, object cnt
+//	per object: int32 layer, index (from 1), bbox min row, min col, max row, max col, run cnt,
+//	then run cnt x int32 (row, first col, last col + 1)
+struct PackedMask {
+	int			layer = 0, index = 0;
+	Vec4i		bbox;
+	vector<Vec3i> runs;
+};
+
+//sort disjoint runs (row, first col, last col + 1) and join the ones that touch
+inline void MergeRuns(vector<Vec3i>& runs) {
+	sort(runs.begin(), runs.end(), [](const Vec3i& a, const Vec3i& b) { return a[0] != b[0] ? a[0] < b[0] : a[1] < b[1]; });
+	int n = 0;
+	for (int k = 0; k < runs.size(); k++) {
+		if (n > 0 && runs[n - 1][0] == runs[k][0] && runs[n - 1][2] == runs[k][1]) runs[n - 1][2] = runs[k][2];
+		else runs[n++] = runs[k];
+	}
+	runs.resize(n);
+}
+
+inline bool WritePackedMasks(const string& path, int h, int w, const vector<PackedMask>& masks) {
+	size_t bytes = 20;
+	for (const PackedMask& m : masks) bytes += 28 + m.runs.size() * 12;
+	BufferedFileWriter out(bytes);
+	const int32_t version = 1;
+	out.PutBytes("IVMK", 4);
+	out.PutPod(version), out.PutPod((int32_t)h), out.PutPod((int32_t)w), out.PutPod((int32_t)masks.size());
+	for (const PackedMask& m : masks) {
+		int32_t hd[7] = { m.layer, m.index, m.bbox[0], m.bbox[1], m.bbox[2], m.bbox[3], (int32_t)m.runs.size() };
+		out.PutBytes(hd, sizeof(hd));
+		for (const Vec3i& run : m.runs) {
+			int32_t v[3] = { run[0], run[1], run[2] };
+			out.PutBytes(v, sizeof(v));
+		}
+	}
+	return out.WriteTo(path);
+}
+
+inline bool ReadPackedMasks(const string& path, int& h, int& w, vector<PackedMask>& masks) {
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp) return false;
+	char magic[4];
+	int32_t hd[4];
+	bool ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, "IVMK", 4) == 0 && fread(hd, sizeof(int32_t), 4, fp) == 4 && hd[0] == 1;
+	if (ok) {
+		h = hd[1], w = hd[2];
+		masks.assign(max(0, hd[3]), PackedMask());
+	}
+	for (int i = 0; ok && i < masks.size(); i++) {
+		int32_t mh[7];
+		ok = fread(mh, sizeof(int32_t), 7, fp) == 7 && mh[6] >= 0;
+		if (!ok) break;
+		PackedMask& m = masks[i];
+		m.layer = mh[0], m.index = mh[1], m.bbox = Vec4i(mh[2], mh[3], mh[4], mh[5]);
+		vector<int32_t> v((size_t)mh[6] * 3);
+		ok = fread(v.data(), sizeof(int32_t), v.size(), fp) == v.size();
+		for (int k = 0; ok && k < mh[6]; k++)
+			m.runs.push_back(Vec3i(v[3 * k], v[3 * k + 1], v[3 * k + 2]));
+	}
+	fclose(fp);
+	return ok;
+}
+
+//Images queued by the compute threads and encoded and written by writer threads of their own, so that
+//PNG compression overlaps with rendering; at most max_queued images wait, Submit blocks beyond that.
+//A submitted Mat is shared, not copied, and must not be modified afterwards.
+class AsyncImageWriter {
+private:
+	struct Item {
+		string		path;
+		Mat			img;
+		vector<int>	params;
+	};
+
+	int					m_thread_cnt;
+	size_t				m_max_queued;
+	vector<thread>		m_threads;
+	deque<Item>			m_queue;
+	mutex				m_mutex;
+	condition_variable	m_cv;
+	int					m_busy_cnt = 0;
+	int					m_failed_cnt = 0;
+	bool				m_stop = false;
+
+	void WriterLoop() {
+		unique_lock<mutex> lock(m_mutex);
+		while (true) {
+			m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+			if (m_queue.empty()) return;
+			Item item = move(m_queue.front());
+			m_queue.pop_front();
+			m_busy_cnt++;
+			m_cv.notify_all();
+			lock.unlock();
+			bool ok = imwrite(item.path, item.img, item.params);
+			lock.lock();
+			m_busy_cnt--;
+			m_failed_cnt += !ok;
+			m_cv.notify_all();
+		}
+	}
+
+public:
+	AsyncImageWriter(int thread_cnt = 2, size_t max_queued = 16) : m_thread_cnt(max(1, thread_cnt)), m_max_queued(max<size_t>(1, max_queued)) {}
+	AsyncImageWriter(const AsyncImageWriter&) = delete;
+	AsyncImageWriter& operator=(const AsyncImageWriter&) = delete;
+
+	~AsyncImageWriter() {
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cv.notify_all();
+		for (thread& t : m_threads) t.join();
+	}
+
+	void Submit(string path, Mat img, vector<int> params = vector<int>()) {
+		unique_lock<mutex> lock(m_mutex);
+		if (m_threads.empty())
+			for (int i = 0; i < m_thread_cnt; i++) m_threads.emplace_back([this] { WriterLoop(); });
+		m_cv.wait(lock, [this] { return m_queue.size() < m_max_queued; });
+		m_queue.push_back({ path, img, params });
+		m_cv.notify_all();
+	}
+
+	//block until every submitted image is written, return the cnt of failed writes since the last call
+	int Wait() {
+		unique_lock<mutex> lock(m_mutex);
+		m_cv.wait(lock, [this] { return m_queue.empty() && m_busy_cnt == 0; });
+		int failed = m_failed_cnt;
+		m_failed_cnt = 0;
+		return failed;
+	}
+};
+
+//writes through the writer when there is one, otherwise right away
+inline void WriteImage(AsyncImageWriter* writer, const string& path, const Mat& img, const vector<int>& params = vector<int>()) {
+	if (writer) writer->Submit(path, img, params);
+	else imwrite(path, img, params);
+}
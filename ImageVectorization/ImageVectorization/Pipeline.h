@@ -0,0 +1,361 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include "RegionSupportingTree.h"
+#include "LayerMerging.h"
+#include "LayerVectorizing.h"
+#include "HierarchicalDecomposition.h"
+#include "TopKResults.h"
+#include "Region.h"
+#include "RegionSegmentation.h"
+#include "Config.h"
+#include "Instrumentation.h"
+
+using namespace std;
+using namespace cv;
+
+//Decomposition of one case (a data directory), split into stages so that they can be run
+//either one after another (Run) or as separate tasks of a thread pool (BatchRunner).
+class DecompositionJob {
+public:
+	string				m_name;
+	string				m_data_dir;
+	VectorizationConfig	m_config;
+	bool				m_in_pool = false;		//stages run as single-threaded pool tasks, so their CPU time is the thread's
+	JobMetrics			m_metrics;
+
+	ImageObj			m_ori_img;
+	RegionInfo			m_reg_info;
+	RegionSupportingTree m_rst;
+	HierarchicalDecomposition m_hierarchy;		//hierarchical mode: region groups and their trees
+	vector<Tree>		m_trees;
+	vector<LayerMerging> m_lms;
+	TopKResults<LayerCandidate> m_results;	//the output_cnt best configurations while they are optimized, in compact form
+	vector<LayerVectorizing> m_lvs;			//those, ranked and in full form, once all are done
+	vector<string>		m_config_lines;			//deterministic mode: the per-configuration lines, printed in order once all are done
+	BoundaryGraph		m_boundary_graph;		//shared by the SVG outputs of all configurations
+	unique_ptr<AsyncImageWriter> m_image_writer;	//encodes the result PNGs while the next ones are rendered
+
+public:
+	DecompositionJob(string data_dir, const VectorizationConfig& config, string name = "") {
+		m_data_dir = data_dir;
+		m_config = config;
+		m_name = name.empty() ? data_dir : name;
+	}
+
+	//0. get input, false if the case can not be preprocessed
+	bool LoadInput() {
+		string input_img_path = m_data_dir + "/input.png";
+		string region_img_path = m_data_dir + "/region.png";
+		string region_ind_path = m_data_dir + "/region_index.png";
+		string region_info_path = m_data_dir + "/region_info.txt";
+		string region_store_path = m_data_dir + "/region.bin";
+
+		cout << "0. read original image, region image and other region info...\n" << endl;
+		ScopedStage stage(m_metrics, "region_load", m_in_pool);
+		if (m_config.tile_size > 0) {
+			//the input is decoded only once, to (re)write the tiles when input.png is newer; the regions come from
+			//the mapped region.bin of ProcessRegionSegImg, so no image is decoded at full size on later runs
+			string tiles_path = m_data_dir + "/input.tiles";
+			if (!TiledImage::IsCurrent(tiles_path, input_img_path, m_config.tile_size)
+				&& !TiledImage::Write(imread(input_img_path), tiles_path, m_config.tile_size)) return false;
+			auto tiles = make_shared<TiledImage>();
+			if (!tiles->Open(tiles_path)) return false;
+			m_ori_img = ImageObj(tiles);
+			if (!m_reg_info.GetAllRegionInfoFromStore(region_store_path)) {
+				cout << "tiled mode needs " << region_store_path << ", preprocess the case with ProcessRegionSegImg first" << endl;
+				return false;
+			}
+			m_reg_info.GroupPixelsByTile(m_config.tile_size, m_ori_img.tiles->tiles_x);
+			return true;
+		}
+
+		Mat input_img = imread(input_img_path);
+		m_ori_img = ImageObj(input_img);
+		//the region files of the case, which may hold user-specified x-junctions, are used when they exist
+		error_code ec;
+		bool has_region_files = filesystem::exists(region_store_path, ec)
+			|| (filesystem::exists(region_info_path, ec) && filesystem::exists(region_img_path, ec));
+		if (m_config.preprocess_in_process || !has_region_files) {
+			RegionSegmentation Seg;
+			Seg.Segment(input_img, imread(m_data_dir + "/seg.png"), imread(m_data_dir + "/mask.png"), m_config.seed);
+			RegionStore store;
+			if (!Seg.ToStore(store)) return false;
+			m_reg_info.GetAllRegionInfoFrom(store.View());
+
+			if (m_config.save_intermediate_files) {
+				Seg.WriteRegionImages(region_img_path, region_ind_path);
+				Seg.WriteRegionInfo(region_info_path);
+				store.Write(region_store_path);
+			}
+		}
+		else if (!m_reg_info.GetAllRegionInfoFromStore(region_store_path))
+			m_reg_info.GetAllRegionInfoFrom(region_img_path, region_info_path);
+		return true;
+	}
+
+	//1. generate region order trees, false if there is no valid tree
+	bool BuildRegionSupportingTrees() {
+		cout << "1. start to generate region supporting trees...\n" << endl;
+		m_rst = RegionSupportingTree(m_ori_img, m_reg_info.regions, m_reg_info.shared_boundary, m_reg_info.xjunction, m_reg_info.possible_bottom_rids);
+		m_rst.SetTreeSearchLimits(m_config.min_tree_depth, m_config.max_tree_depth, m_config.l1_node_divisor, m_config.relaxed_l1_node_divisor);
+		{
+			ScopedStage stage(m_metrics, "graph_build", m_in_pool);
+			m_rst.BuildAdjacentRegionGraph();
+		}
+		{
+			ScopedStage stage(m_metrics, "enumeration", m_in_pool);
+			m_rst.GetValidRegionSupportingTrees();
+		}
+		m_trees = m_rst.m_valid_region_support_trees;
+
+		m_metrics.SetCounter("regions", m_reg_info.regions.size() - 1);
+		m_metrics.SetCounter("graph_edges", m_rst.GetSimplifiedEdgeSize());
+		m_metrics.SetCounter("tree_search_rounds", m_rst.m_search_round_cnt);
+		m_metrics.SetCounter("branches_pruned", m_rst.m_pruned_branch_cnt);
+		m_metrics.SetCounter("trees_enumerated", m_rst.m_enumerated_tree_cnt);
+		m_metrics.SetCounter("trees_valid", m_trees.size());
+		m_metrics.SetCounter("trees_rejected", m_rst.m_enumerated_tree_cnt - (int)m_trees.size());
+		m_lms.clear();
+		m_lms.resize(m_trees.size());
+		return !m_trees.empty();
+	}
+
+	//hierarchical mode, in place of BuildRegionSupportingTrees when there are more regions than a group may hold
+	bool UseHierarchicalMode() const {
+		return m_config.max_group_regions > 0 && (int)m_reg_info.regions.size() - 1 > m_config.max_group_regions;
+	}
+
+	//1.1 cluster the regions into groups, return the group cnt
+	int GroupRegions() {
+		cout << "1. start to group regions...\n" << endl;
+		ScopedStage stage(m_metrics, "grouping", m_in_pool);
+		m_hierarchy.ClusterRegions(m_reg_info, m_config.max_group_regions);
+		int largest = 0;
+		for (const RegionGroup& G : m_hierarchy.groups) largest = max(largest, (int)G.rids.size());
+		cout << m_reg_info.regions.size() - 1 << " regions in " << m_hierarchy.groups.size() << " groups, the largest has " << largest << endl;
+		m_metrics.SetCounter("regions", m_reg_info.regions.size() - 1);
+		m_metrics.SetCounter("region_groups", m_hierarchy.groups.size());
+		m_metrics.SetCounter("largest_group", largest);
+		return m_hierarchy.groups.size();
+	}
+
+	//1.2 order the regions of the g-th group
+	void SolveRegionGroup(int g) {
+		ScopedStage stage(m_metrics, "group_solve", true);
+		m_hierarchy.SolveGroup(g, m_reg_info, &m_ori_img, m_config);
+	}
+
+	//1.3 order the groups and join their trees into the one tree of the case, whose configuration is then
+	//merged and optimized jointly by the stages below; false if the joined tree breaks an x-junction
+	bool JoinRegionGroups() {
+		ScopedStage stage(m_metrics, "group_ordering", m_in_pool);
+		m_hierarchy.OrderGroups(m_reg_info);
+		Tree tree;
+		if (!m_hierarchy.JoinGroupTrees(m_reg_info, tree))
+			return false;
+		m_trees.assign(1, tree);
+
+		int tree_cnt = 0, no_tree_cnt = 0;
+		for (const RegionGroup& G : m_hierarchy.groups) tree_cnt += G.tree_cnt, no_tree_cnt += G.tree_cnt == 0;
+		m_metrics.SetCounter("trees_enumerated", tree_cnt);
+		m_metrics.SetCounter("groups_without_tree", no_tree_cnt);
+		m_metrics.SetCounter("trees_valid", m_trees.size());
+		m_lms.clear();
+		m_lms.resize(m_trees.size());
+		return true;
+	}
+
+	//2. layer merging of the ind-th tree
+	void MergeLayers(int ind) {
+		ScopedStage stage(m_metrics, "merging", true);
+		m_lms[ind] = LayerMerging(m_trees[ind]);
+		m_lms[ind].DetermineLayerRange();
+	}
+
+	//2.1 deduplicate layer configurations, return the remaining configuration cnt
+	int DeduplicateLayerConfigurations() {
+		ScopedStage stage(m_metrics, "dedup", m_in_pool);
+		int config_cnt = m_lms.size();
+		for (int i = 0; i + 1 < m_lms.size(); i++) {
+			for (int j = m_lms.size() - 1; j > i; j--)
+				if (m_lms[i].LayerConfigurationEquals(m_lms[j]))
+					m_lms.erase(m_lms.begin() + j);
+		}
+		cout << "after deduplicate, tree cnt:" << m_lms.size() << endl;
+		m_metrics.SetCounter("configs", m_lms.size());
+		m_metrics.SetCounter("configs_deduplicated", config_cnt - (int)m_lms.size());
+		m_lvs.clear();
+		m_results.Reset(max(0, m_config.output_cnt));
+		m_config_lines.assign(m_config.deterministic ? m_lms.size() : 0, "");
+		return m_lms.size();
+	}
+
+	//the loss a configuration has to beat to be among the results, infinity until output_cnt are done
+	double ResultThreshold() const {
+		return m_results.Threshold();
+	}
+
+	//3. layer parameter optimization of the ind-th configuration; the result is kept, as a candidate, only
+	//while it is among the output_cnt best so far. A single configuration, as in hierarchical mode, spreads
+	//its loss evaluations over the cores instead, unless the pool already keeps them busy; deterministic mode
+	//sums such a loss in blocks in the pool too (on one thread), so both modes give the same result. In
+	//hierarchical mode the objects start from the params of their regions in the group configurations
+	void VectorizeLayers(int ind) {
+		bool parallel_loss = (!m_in_pool || m_config.deterministic) && m_lms.size() == 1;
+		ScopedStage stage(m_metrics, "optimization", m_in_pool || !parallel_loss);
+		vector<vector<double>> init_vars;
+		if (UseHierarchicalMode()) init_vars = m_hierarchy.RegionVars(m_reg_info.regions.size());
+		LayerVectorizing lv(&m_reg_info.regions, &m_ori_img, m_lms[ind].GetLayerObject());
+		lv.m_sample_n = m_config.sample_n;
+		lv.m_max_eval = m_config.max_eval;
+		lv.m_xtol = m_config.xtol;
+		lv.m_wr = m_config.w_recon;
+		lv.m_wg = m_config.w_gamut;
+		lv.m_wc = m_config.w_complexity;
+		lv.m_parallel_loss = parallel_loss;
+		lv.m_init_region_vars = init_vars.empty() ? nullptr : &init_vars;
+		m_lms[ind] = LayerMerging();
+		lv.CalculateLayerObjectParamsWithGlobalOptimization();
+		lv.CalculateTotalLoss();
+		string line = "config " + to_string(ind) + " has been decomposed!";
+		if (m_config.deterministic) m_config_lines[ind] = line;
+		else cout << line << endl;
+
+		ConfigRecord rec;
+		rec.config_id = ind;
+		rec.wall = stage.WallElapsed();
+		rec.cpu = stage.CpuElapsed();
+		rec.layer_cnt = (int)lv.m_layer_cnt;
+		rec.sample_cnt = lv.m_sample_cnt;
+		rec.eval_cnt = lv.m_eval_cnt;
+		rec.loss = lv.m_total_loss;
+		m_metrics.AddConfig(rec);
+		m_results.Push(rec.loss, ind, lv.TakeCandidate());
+	}
+
+	//4. take the kept configurations ranked by loss into their full form, return the cnt of results to output;
+	//the region boundaries are traced and fitted here once, as all configurations share the regions
+	int SortResults() {
+		for (const string& line : m_config_lines)
+			cout << line << endl;
+		m_metrics.SetCounter("configs_dropped", m_results.DroppedCnt());
+		m_lvs.clear();
+		for (LayerCandidate& cand : m_results.TakeSorted())
+			m_lvs.push_back(LayerVectorizing(&m_reg_info.regions, &m_ori_img, move(cand)));
+		cout << endl << "4. start to output layer and reconstruted image...\n" << endl;
+		int output_cnt = m_lvs.size();
+		if (output_cnt > 0) m_image_writer = make_unique<AsyncImageWriter>();
+		if (m_config.write_svg && output_cnt > 0) {
+			ScopedStage stage(m_metrics, "boundary_graph", m_in_pool);
+			m_boundary_graph = m_lvs[0].BuildBoundaryGraph(m_config.svg_fit_tolerance);
+			m_metrics.SetCounter("boundary_chains", m_boundary_graph.chains.size());
+		}
+		return output_cnt;
+	}
+
+	void OutputResult(int ind) {
+		ScopedStage stage(m_metrics, "output", true);
+		string output_vectorize_path = m_data_dir + "/results/";
+		string output_json_path = m_data_dir + "/results/for_vectorize/";
+		string output_layer_mask_path = m_data_dir + "/results/for_vectorize/";
+
+		bool rgba = m_config.layer_format != "preview";
+		if (rgba)
+			m_lvs[ind].OutputRgbaLayers(output_vectorize_path + to_string(ind), m_config.layer_format == "premultiplied", m_image_writer.get());
+		if (!rgba || m_config.layer_preview) {
+			m_lvs[ind].GenerateResultingLayers();
+			m_lvs[ind].SaveReconstructedImageAndLayers(output_vectorize_path + to_string(ind), m_image_writer.get());
+		}
+		m_lvs[ind].OutputJsonForPresentation(output_json_path + to_string(ind) + "/param.json");
+		if (m_config.mask_format == "png")
+			m_lvs[ind].OutputLayerMask(output_layer_mask_path + to_string(ind) + "/", m_image_writer.get());
+		else if (m_config.mask_format == "packed")
+			m_lvs[ind].OutputPackedLayerMasks(output_layer_mask_path + to_string(ind) + "/masks.bin");
+		if (m_config.write_svg)
+			m_lvs[ind].OutputSvg(output_vectorize_path + to_string(ind) + ".svg", m_boundary_graph);
+		m_lvs[ind].ReleaseImages();
+	}
+
+	//wait for the queued images of all results, then stop the writer threads
+	void FinishOutput() {
+		if (!m_image_writer) return;
+		ScopedStage stage(m_metrics, "image_write_wait", true);
+		int failed_cnt = m_image_writer->Wait();
+		m_image_writer.reset();
+		m_metrics.SetCounter("image_write_failures", failed_cnt);
+		if (failed_cnt) cout << "case " << m_name << ": " << failed_cnt << " images could not be written" << endl;
+	}
+
+	//free everything but the name, once the results are written
+	void Release() {
+		m_ori_img = ImageObj();
+		m_reg_info = RegionInfo();
+		m_rst = RegionSupportingTree();
+		m_hierarchy = HierarchicalDecomposition();
+		vector<Tree>().swap(m_trees);
+		vector<LayerMerging>().swap(m_lms);
+		m_results.Reset(0);
+		vector<LayerVectorizing>().swap(m_lvs);
+		vector<string>().swap(m_config_lines);
+		m_boundary_graph = BoundaryGraph();
+		m_image_writer.reset();
+	}
+
+	//case wall time, stage times and counters: printed, and appended to the metrics file when configured
+	void ReportMetrics(bool ok, double wall, double cpu) {
+		m_metrics.AddStage("total", wall, cpu);
+		cout << "case " << m_name << (ok ? "" : " (failed)") << ": " << wall << " s wall, " << cpu << " s cpu" << endl;
+		if (!m_config.metrics_path.empty())
+			m_metrics.AppendJsonLine(m_config.metrics_path, m_name, ok);
+	}
+
+	//the whole decomposition in the calling thread, each stage parallelized with OpenMP
+	bool Run() {
+		double wall0 = WallSeconds(), cpu0 = CpuSeconds(false);
+		bool ok = RunStages();
+		ReportMetrics(ok, WallSeconds() - wall0, CpuSeconds(false) - cpu0);
+		return ok;
+	}
+
+private:
+	bool RunStages() {
+		if (!LoadInput())
+			return false;
+		if (UseHierarchicalMode()) {
+			int group_cnt = GroupRegions();
+#pragma omp parallel for schedule(dynamic)
+			for (int g = 0; g < group_cnt; g++)
+				SolveRegionGroup(g);
+			if (!JoinRegionGroups())
+				return false;
+		}
+		else if (!BuildRegionSupportingTrees())
+			return false;
+
+		cout << "2. start to merge layers...\n" << endl;
+#pragma omp parallel for
+		for (int ind = 0; ind < (int)m_lms.size(); ind++)
+			MergeLayers(ind);
+		int config_cnt = DeduplicateLayerConfigurations();
+
+		cout << "3. start to estimate layer parameters...\n" << endl;
+#pragma omp parallel for if(config_cnt > 1)
+		for (int ind = 0; ind < config_cnt; ind++)
+			VectorizeLayers(ind);
+
+		int output_cnt = SortResults();
+#pragma omp parallel for
+		for (int ind = 0; ind < output_cnt; ind++)
+			OutputResult(ind);
+		FinishOutput();
+		m_metrics.SetCounter("results_written", output_cnt);
+		return true;
+	}
+};
@@ -3,36 +3,169 @@
 #include <iostream>
 #include <vector>
 #include <set>
+#include <map>
+#include <algorithm>
+#include <climits>
 #include <Eigen/Core>
 #include <opencv2/opencv.hpp>
 #include <fstream>
 #include "Utility.h"
 #include "Xjunction.h"
+#include "RegionStore.h"
+#include "SharedBoundary.h"
+#include "BoundaryScan.h"
 
 using namespace std;
 using namespace Eigen;
 using namespace cv;
 
+//raw moments of a region's pixels, x the row and y the column as in the layer gradients
+struct RegionMoments {
+	double m00 = 0, m10 = 0, m01 = 0, m20 = 0, m11 = 0, m02 = 0;
+};
+
 class Region {
 public:
 	int					m_region_id;
 	set<int>			m_adj_regions;
 	Vec3i				m_region_color;
-	vector<int>			m_region_pids;
+	vector<RegionRun>	m_runs;				//the region's pixels as row-sorted horizontal runs
+	vector<int>			m_run_starts;		//index of each run's first pixel among the region's pixels, then the pixel cnt
 	vector<MatrixXd>	m_layer_params;
 	MatrixXd			m_recon_pix_colors;
 	Vec4i				m_bbox;
-	vector<int>			m_shared_pixcnt_with_reg;
 	double				m_perimeter;
 	bool				m_is_at_bottom;
+	vector<Vec2i>		m_tile_starts;		//tiled mode: (tile, first index in m_runs) of every tile the region has pixels in
+	vector<int>			m_raster_order;		//tiled mode: the index in m_runs of every run in raster order
 
 public:
-	Region() { m_is_at_bottom = false; }
-	Region(int region_id, set<int> adjacent_regions, vector<int> region_pix_index) {
+	Region() { m_is_at_bottom = false; m_run_starts.push_back(0); }
+	Region(int region_id, set<int> adjacent_regions, const vector<RegionRun>& runs) {
 		m_region_id = region_id;
 		m_adj_regions = adjacent_regions;
-		m_region_pids = region_pix_index;
 		m_is_at_bottom = false;
+		m_run_starts.push_back(0);
+		for (const RegionRun& run : runs) AddRun(run.row, run.col_begin, run.col_end);
+	}
+
+	int PixelCnt() const { return m_run_starts.back(); }
+
+	//append pixels in raster order; a pixel right after the last run extends it
+	void AddRun(int row, int col_begin, int col_end) {
+		if (!m_runs.empty() && m_runs.back().row == row && m_runs.back().col_end == col_begin) {
+			m_runs.back().col_end = col_end;
+			m_run_starts.back() += col_end - col_begin;
+			return;
+		}
+		m_runs.push_back({ row, col_begin, col_end });
+		m_run_starts.push_back(m_run_starts.back() + col_end - col_begin);
+	}
+
+	void AddPixel(int row, int col) { AddRun(row, col, col + 1); }
+
+	//id of the k-th pixel, in run order
+	int PixelAt(int k, int w) const {
+		int i = upper_bound(m_run_starts.begin(), m_run_starts.end(), k) - m_run_starts.begin() - 1;
+		return m_runs[i].row * w + m_runs[i].col_begin + k - m_run_starts[i];
+	}
+
+	//pixels 0, step, 2 * step, ... in raster order with step = cnt / n, appended to pids; the runs are walked
+	//once, in raster order in tiled mode too, so the samples do not depend on the tile size
+	void SamplePixels(int n, int w, vector<int>& pids) const {
+		int k = PixelCnt(), i = 0, start = 0;
+		auto run_at = [&](int i) -> const RegionRun& { return m_runs[m_raster_order.empty() ? i : m_raster_order[i]]; };
+		auto len = [&](int i) { return run_at(i).col_end - run_at(i).col_begin; };
+		double step = k * 1.0 / n;
+		for (double j = 0; j < k; j += step) {
+			while (start + len(i) <= int(j)) start += len(i++);
+			pids.push_back(run_at(i).row * w + run_at(i).col_begin + int(j) - start);
+		}
+	}
+
+	template<typename F>
+	void ForEachPixel(int w, F f) const {
+		for (const RegionRun& run : m_runs)
+			for (int pid = run.row * w + run.col_begin, end = run.row * w + run.col_end; pid < end; pid++)
+				f(pid);
+	}
+
+	void AppendPixels(int w, vector<int>& pids) const {
+		pids.reserve(pids.size() + PixelCnt());
+		ForEachPixel(w, [&](int pid) { pids.push_back(pid); });
+	}
+
+	//set the region's pixels of a row-major h x w map
+	template<typename T>
+	void Rasterize(T* map, int w, T value) const {
+		for (const RegionRun& run : m_runs)
+			fill(map + (size_t)run.row * w + run.col_begin, map + (size_t)run.row * w + run.col_end, value);
+	}
+
+	//(min row, min col, max row, max col) of the pixels, (INT_MAX, INT_MAX, -1, -1) if there are none
+	Vec4i PixelBbox() const {
+		Vec4i bbox(INT_MAX, INT_MAX, -1, -1);
+		for (const RegionRun& run : m_runs)
+			bbox = Vec4i(min(bbox[0], run.row), min(bbox[1], run.col_begin), max(bbox[2], run.row), max(bbox[3], run.col_end - 1));
+		return bbox;
+	}
+
+	//in closed form per run: a run of n pixels in row r from column c0 adds n, n * r, sum c, ...
+	RegionMoments Moments() const {
+		RegionMoments m;
+		auto sum_to = [](double c) { return c * (c + 1) / 2; };					//0 + 1 + ... + c
+		auto sq_sum_to = [](double c) { return c * (c + 1) * (2 * c + 1) / 6; };	//0 + 1 + ... + c^2
+		for (const RegionRun& run : m_runs) {
+			double n = run.col_end - run.col_begin, r = run.row;
+			double sc = sum_to(run.col_end - 1) - sum_to(run.col_begin - 1);
+			double sc2 = sq_sum_to(run.col_end - 1) - sq_sum_to(run.col_begin - 1);
+			m.m00 += n, m.m10 += n * r, m.m01 += sc;
+			m.m20 += n * r * r, m.m11 += r * sc, m.m02 += sc2;
+		}
+		return m;
+	}
+
+	//tiled mode: cut the runs at the tile columns and reorder them tile by tile, keeping raster order
+	//within a tile (a counting sort over the tiles the runs span), and index where each tile starts
+	void GroupPixelsByTile(int tile_size, int tiles_x) {
+		m_tile_starts.clear();
+		m_raster_order.clear();
+		if (m_runs.empty()) return;
+
+		vector<RegionRun> cut;
+		for (const RegionRun& run : m_runs)
+			for (int c = run.col_begin; c < run.col_end; c = (c / tile_size + 1) * tile_size)
+				cut.push_back({ run.row, c, min(run.col_end, (c / tile_size + 1) * tile_size) });
+		auto tile_of = [&](const RegionRun& run) { return run.row / tile_size * tiles_x + run.col_begin / tile_size; };
+
+		int ty0 = cut.front().row / tile_size, ty1 = cut.back().row / tile_size, tx0 = INT_MAX, tx1 = -1;
+		for (const RegionRun& run : cut)
+			tx0 = min(tx0, run.col_begin / tile_size), tx1 = max(tx1, run.col_begin / tile_size);
+		int bw = tx1 - tx0 + 1;
+		auto local = [&](int tile) { return (tile / tiles_x - ty0) * bw + tile % tiles_x - tx0; };
+
+		vector<int> starts((size_t)(ty1 - ty0 + 1) * bw + 1, 0);
+		for (const RegionRun& run : cut) starts[local(tile_of(run)) + 1]++;
+		for (int i = 1; i < starts.size(); i++) starts[i] += starts[i - 1];
+		for (int i = 0; i + 1 < starts.size(); i++)
+			if (starts[i + 1] > starts[i])
+				m_tile_starts.push_back(Vec2i((ty0 + i / bw) * tiles_x + tx0 + i % bw, starts[i]));
+
+		m_runs.resize(cut.size());
+		m_raster_order.resize(cut.size());
+		for (int k = 0; k < cut.size(); k++) {
+			m_raster_order[k] = starts[local(tile_of(cut[k]))]++;
+			m_runs[m_raster_order[k]] = cut[k];
+		}
+		m_run_starts.assign(1, 0);
+		for (const RegionRun& run : m_runs) m_run_starts.push_back(m_run_starts.back() + run.col_end - run.col_begin);
+	}
+
+	//[begin, end) of the runs in tile, empty if the region has none there
+	Vec2i TileRunRange(int tile) const {
+		auto it = lower_bound(m_tile_starts.begin(), m_tile_starts.end(), tile, [](const Vec2i& s, int t) { return s[0] < t; });
+		if (it == m_tile_starts.end() || (*it)[0] != tile) return Vec2i(0, 0);
+		return Vec2i((*it)[1], it + 1 == m_tile_starts.end() ? (int)m_runs.size() : (*(it + 1))[1]);
 	}
 
 	bool Enclose(Region& R1) {
@@ -44,8 +177,8 @@ public:
 		if (Enclose(R2)) return true;
 		if (R2.Enclose(*this)) return false;
 
-		int r1_area = m_region_pids.size();
-		int r2_area = R2.m_region_pids.size();
+		int r1_area = PixelCnt();
+		int r2_area = R2.PixelCnt();
 		return (r1_area >= r2_area * 2.0 / 3);
 	}
 };
@@ -58,11 +191,21 @@ public:
 	vector<int>		possible_bottom_rids;
 	Xjunction		xjunction;
 	vector<int>		pix_region_ids;
+	SharedBoundaryTable shared_boundary;		//boundary pixcnt shared by adjacent regions
 
+	RegionInfo() {}
 	RegionInfo(string region_img_path, string region_param_path) {
 		GetAllRegionInfoFrom(region_img_path, region_param_path);
 	}
 
+	//tiled mode: group every region's runs by tile; the per-pixel region ids are dropped, nothing reads them
+	void GroupPixelsByTile(int tile_size, int tiles_x) {
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 1; i < (int)regions.size(); i++)
+			regions[i].GroupPixelsByTile(tile_size, tiles_x);
+		vector<int>().swap(pix_region_ids);
+	}
+
 	int GetInitialEdgeCnt() {
 		int en = regions.size() - 1;
 		for (int i = 1; i < regions.size(); i++) {
@@ -86,9 +229,6 @@ public:
 		region_param << 0, 0, 0, 0, 0, 0, 1, 1, 1;
 		regions[0].m_layer_params.push_back(region_param);
 
-		for (int i = 0; i < regions.size(); i++)
-			regions[i].m_shared_pixcnt_with_reg.resize(regions.size(), 0);
-
 		//2. read other regions' parameters and mask colors========================
 		map<Vec3i, int, vec3icmp> mp;
 		for (int i = 1; i <= region_num; i++) {
@@ -104,15 +244,14 @@ public:
 			regions[i].m_bbox = bbox;
 		}
 
-		//3. record each region's pix ids================================================
+		//3. record each region's pixel runs================================================
 		ImageObj region_img(region_img_path);
 		pix_region_ids.resize(region_img.h * region_img.w, 0);
-		for (int i = 0; i < region_img.colors.size(); i++) {
-			Vec3i color = region_img.colors[i] * 255;
-			int row = i / region_img.w, col = i % region_img.w;
+		for (int i = 0; i < region_img.h * region_img.w; i++) {
+			Vec3i color = region_img.GetColor255(i);
 			if (mp.find(color) != mp.end()) {
 				int region_id = mp[color];
-				regions[region_id].m_region_pids.push_back(i);
+				regions[region_id].AddPixel(i / region_img.w, i % region_img.w);
 				pix_region_ids[i] = region_id;
 			}
 		}
@@ -150,28 +289,77 @@ public:
 		xjunction = Xjunction(xjunction_vec);
 
 		//7. record adjacent region boundary pixcnt
+		LabelBoundaryInfo boundary = ScanLabelBoundaries(pix_region_ids.data(), region_img.h, region_img.w, regions.size());
+		shared_boundary.Clear();
+		shared_boundary.EndRegion();
 		for (int rid = 1; rid < regions.size(); rid++) {
-			double perimeter = 0;
-			double max_share_boundary = -1;
-			for (int j : regions[rid].m_region_pids) {
-				vector<Vec2i> neighbor_pids = region_img.GetAllNeighbors(j);
-				for (Vec2i location_pid : neighbor_pids) {
-					bool inside = location_pid[0];
-					int pid = location_pid[1];
-					if (inside) {
-						int nb_rid = pix_region_ids[pid];
-						if (rid != nb_rid) {
-							regions[rid].m_shared_pixcnt_with_reg[nb_rid]++;
-							perimeter++;
-						}
-					}
-					else {
-						regions[rid].m_shared_pixcnt_with_reg[0]++;
-						perimeter++;
-					}
-				}
-			}
-			regions[rid].m_perimeter = perimeter;
+			regions[rid].m_perimeter = boundary.perimeter[rid];
+			boundary.ForEachNeighborOf(rid, [&](int nb_rid, int pixcnt) {
+				shared_boundary.PushBack(nb_rid, pixcnt);
+			});
+			shared_boundary.EndRegion();
+		}
+	}
+
+	//read the binary region file (region.bin) written by ProcessRegionSegImg, false if it is missing or invalid
+	bool GetAllRegionInfoFromStore(string region_store_path) {
+		MappedRegionStore store;
+		if (!store.Open(region_store_path))
+			return false;
+		GetAllRegionInfoFrom(store.view);
+		return true;
+	}
+
+	void GetAllRegionInfoFrom(const RegionStoreView& store) {
+		int region_cnt = store.region_cnt;
+		regions.clear();
+		regions.resize(region_cnt);
+
+		//1. define the canvas region==============================================
+		regions[0].m_region_id = 0;
+		for (int i = 1; i < regions.size(); i++)
+			regions[0].m_adj_regions.insert(i);
+
+		MatrixXd region_param(3, 3);
+		region_param << 0, 0, 0, 0, 0, 0, 1, 1, 1;
+		regions[0].m_layer_params.push_back(region_param);
+
+		shared_boundary.Clear();
+		shared_boundary.EndRegion();
+
+		//2. region's color, bbox, pixels, adjacent regions and boundary pixcnt====
+		for (int i = 1; i < region_cnt; i++) {
+			Region& R = regions[i];
+			R.m_region_id = i;
+			R.m_region_color = Vec3i(store.colors[3 * i], store.colors[3 * i + 1], store.colors[3 * i + 2]);
+			R.m_bbox = Vec4i(store.bboxes[4 * i], store.bboxes[4 * i + 1], store.bboxes[4 * i + 2], store.bboxes[4 * i + 3]);
+			R.m_perimeter = store.perimeters[i];
+
+			R.m_runs.reserve(store.run_offsets[i + 1] - store.run_offsets[i]);
+			for (int j = store.run_offsets[i]; j < store.run_offsets[i + 1]; j++)
+				R.AddRun(store.runs[j].row, store.runs[j].col_begin, store.runs[j].col_end);
+
+			R.m_adj_regions.insert(store.adj_rids + store.adj_offsets[i], store.adj_rids + store.adj_offsets[i + 1]);
+
+			for (int j = store.boundary_offsets[i]; j < store.boundary_offsets[i + 1]; j++)
+				shared_boundary.PushBack(store.boundaries[j].nb_rid, store.boundaries[j].pixcnt);
+			shared_boundary.EndRegion();
 		}
+
+		//3. each pixel's region id================================================
+		pix_region_ids.assign(store.label_map, store.label_map + (size_t)store.h * store.w);
+
+		//4. possible bottom regions===============================================
+		possible_bottom_rids.assign(store.bottom_rids, store.bottom_rids + store.bottom_cnt);
+		if (possible_bottom_rids.size() == 1)
+			regions[possible_bottom_rids[0]].m_is_at_bottom = true;
+
+		//5. xjunction info========================================================
+		vector<Vec4i> xjunction_vec;
+		for (int i = 0; i < store.xjunction_cnt; i++) {
+			const int32_t* xj = store.xjunctions + 4 * i;
+			xjunction_vec.push_back(Vec4i(xj[0], xj[1], xj[2], xj[3]));
+		}
+		xjunction = Xjunction(xjunction_vec);
 	}
 };
\ No newline at end of file
@@ -8,13 +8,12 @@
 #include <iomanip>
 #include <iostream>
 #include <opencv2/opencv.hpp>
-#include "io.h"
-#include <direct.h>
 #include "Region.h"
 #include "Graph.h"
 #include "Tree.h"
 #include "Xjunction.h"
 #include "Utility.h"
+#include "SharedBoundary.h"
 
 using namespace std;
 using namespace cv;
@@ -26,22 +25,39 @@ private:
 	Xjunction		m_xjunction;					//x-junctions in the region image
 	vector<int>		m_possible_bottom_rids;
 	vector<int>		m_pix_rid;						//record pix's region
+	SharedBoundaryTable m_shared_boundary;			//boundary pixcnt shared by adjacent regions
+
+	//tree search limits, the depth limit grows from min to max until trees are found
+	int				m_min_tree_depth = 3;
+	int				m_max_tree_depth = 8;
+	int				m_l1_node_divisor = 3;			//at most region cnt / divisor nodes right under the canvas
+	int				m_relaxed_l1_node_divisor = 2;	//used when fewer than 2 trees are found
 
 public:
 	vector<Region>	m_regions;						//regions in the input image
 	vector<Tree>	m_valid_region_support_trees;	//region order tree
 
+	//tree search counters
+	int				m_search_round_cnt = 0;			//enumerations run while relaxing the limits
+	long long		m_pruned_branch_cnt = 0;		//branches cut by the x-junction test, over all rounds
+	int				m_enumerated_tree_cnt = 0;		//spanning trees of the last round
+
 public:
-	RegionSupportingTree() {
-		srand(time(0));
-	}
+	RegionSupportingTree() {}
 
-	RegionSupportingTree(ImageObj& ori_img, vector<Region>& regs, Xjunction& xj, vector<int>& possible_bot_rids) {
+	RegionSupportingTree(ImageObj& ori_img, vector<Region>& regs, SharedBoundaryTable& shared_boundary, Xjunction& xj, vector<int>& possible_bot_rids) {
 		m_ori_img = ori_img;
 		m_regions = regs;
+		m_shared_boundary = shared_boundary;
 		m_xjunction = xj;
 		m_possible_bottom_rids = possible_bot_rids;
-		srand(time(0));
+	}
+
+	void SetTreeSearchLimits(int min_depth, int max_depth, int l1_node_divisor, int relaxed_l1_node_divisor) {
+		m_min_tree_depth = min_depth;
+		m_max_tree_depth = max_depth;
+		m_l1_node_divisor = l1_node_divisor;
+		m_relaxed_l1_node_divisor = relaxed_l1_node_divisor;
 	}
 
 	int GetSimplifiedEdgeSize() {
@@ -67,12 +83,12 @@ public:
 			vector<int> rids = whoSupportRegion[i];
 			for (int rid : rids) {
 				//if (rid == 0) continue;
-				max_share_boundary_length = max(max_share_boundary_length, m_regions[i].m_shared_pixcnt_with_reg[rid]);
+				max_share_boundary_length = max(max_share_boundary_length, m_shared_boundary.PixCnt(i, rid));
 			}
 
 			for (int rid : rids) {
 				//if (rid == 0) continue;
-				if (m_regions[i].m_shared_pixcnt_with_reg[rid] < max_share_boundary_length * 0.4)
+				if (m_shared_boundary.PixCnt(i, rid) < max_share_boundary_length * 0.4)
 					if (!m_xjunction.ContainsRegions(rid, i))
 						to_remove_edges.push_back(Vec2i(rid, i));
 			}
@@ -159,24 +175,29 @@ public:
 
 	void GetValidRegionSupportingTrees() {
 		//1. Get all valid region supporting trees
-		int tree_depth = 3;
+		int tree_depth = m_min_tree_depth;
 		vector<vector<Vec2i>> all_spanning_trees;
 		while (1) {
-			Graph Gx(m_regions.size(), m_adj_region_graph_edges, tree_depth, m_regions.size() / 3);
+			Graph Gx(m_regions.size(), m_adj_region_graph_edges, tree_depth, m_regions.size() / m_l1_node_divisor);
 			Gx.SetXjunctions(m_xjunction.Conver2Arrrint4());
 			all_spanning_trees = Gx.GetAllSpanningTrees();
-			if (!all_spanning_trees.empty() || tree_depth >= 8) break;
+			m_search_round_cnt++;
+			m_pruned_branch_cnt += Gx.pruned_branch_cnt;
+			if (!all_spanning_trees.empty() || tree_depth >= m_max_tree_depth) break;
 			tree_depth++;
 		}
 
-		tree_depth = 3;
+		tree_depth = m_min_tree_depth;
 		while (all_spanning_trees.size() < 2) {
-			Graph Gx(m_regions.size(), m_adj_region_graph_edges, tree_depth, m_regions.size() / 2);
+			Graph Gx(m_regions.size(), m_adj_region_graph_edges, tree_depth, m_regions.size() / m_relaxed_l1_node_divisor);
 			Gx.SetXjunctions(m_xjunction.Conver2Arrrint4());
 			all_spanning_trees = Gx.GetAllSpanningTrees();
-			if (all_spanning_trees.size() > 1 || tree_depth >= 8)break;
+			m_search_round_cnt++;
+			m_pruned_branch_cnt += Gx.pruned_branch_cnt;
+			if (all_spanning_trees.size() > 1 || tree_depth >= m_max_tree_depth)break;
 			tree_depth++;
 		}
+		m_enumerated_tree_cnt = all_spanning_trees.size();
 		cout << endl << "all spanning tree cnt: " << all_spanning_trees.size() << endl;
 		
 		int k = 0;
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//boundary pixcnt shared by adjacent regions, stored sparsely (CSR):
+//the neighbors of region rid are m_nb_rids[m_offsets[rid]] ... m_nb_rids[m_offsets[rid + 1] - 1], sorted by id
+class SharedBoundaryTable {
+private:
+	vector<int> m_offsets;
+	vector<int> m_nb_rids;
+	vector<int> m_pixcnts;
+
+public:
+	SharedBoundaryTable() { Clear(); }
+
+	void Clear() {
+		m_offsets.assign(1, 0);
+		m_nb_rids.clear();
+		m_pixcnts.clear();
+	}
+
+	//rows are appended in region id order, a row's neighbors in increasing id order
+	void PushBack(int nb_rid, int pixcnt) {
+		m_nb_rids.push_back(nb_rid);
+		m_pixcnts.push_back(pixcnt);
+	}
+
+	void EndRegion() {
+		m_offsets.push_back(m_nb_rids.size());
+	}
+
+	int RegionCnt() const {
+		return (int)m_offsets.size() - 1;
+	}
+
+	int NeighborCnt(int rid) const {
+		return m_offsets[rid + 1] - m_offsets[rid];
+	}
+
+	int NeighborAt(int rid, int k) const {
+		return m_nb_rids[m_offsets[rid] + k];
+	}
+
+	int PixCntAt(int rid, int k) const {
+		return m_pixcnts[m_offsets[rid] + k];
+	}
+
+	//pixcnt of rid's boundary shared with nb_rid, 0 if they are not adjacent
+	int PixCnt(int rid, int nb_rid) const {
+		auto begin = m_nb_rids.begin() + m_offsets[rid];
+		auto end = m_nb_rids.begin() + m_offsets[rid + 1];
+		auto it = lower_bound(begin, end, nb_rid);
+		if (it == end || *it != nb_rid) return 0;
+		return m_pixcnts[it - m_nb_rids.begin()];
+	}
+};
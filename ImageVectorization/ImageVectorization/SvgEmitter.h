@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Core>
+#include <opencv2/opencv.hpp>
+#include "OutputWriters.h"
+
+using namespace std;
+using namespace cv;
+using namespace Eigen;
+
+//SVG output of a decomposition, one <linearGradient> and one <path> per object, one <g> per layer,
+//in the format of Gen_svg_script/main.py
+
+//no channel varies over the image, the object is drawn with a flat fill instead of a gradient
+inline bool IsFlatFill(const MatrixXd& param) {
+	for (int k = 0; k < param.cols(); k++)
+		if (fabs(param(0, k)) >= 1e-7 || fabs(param(1, k)) >= 1e-7) return false;
+	return true;
+}
+
+//direction of the gradient in image (row, column) space, taken from the first color channel that varies along rows,
+//in [0, pi] with a non-negative column component; param: 3 x 4, rows are the row, column and constant terms
+//of the normalized coordinates row / (h - 1) and col / (w - 1), cols are r, g, b, a (as Object::param)
+inline double GradientAngle(const MatrixXd& param, int h, int w) {
+	bool no_row_term = true, no_col_term = true;
+	for (int k = 0; k < param.cols(); k++) {
+		no_row_term = no_row_term && fabs(param(0, k)) < 1e-7;
+		no_col_term = no_col_term && fabs(param(1, k)) < 1e-7;
+	}
+	if (no_row_term) return CV_PI / 2;
+	if (no_col_term) return 0;
+	int k = 0;
+	while (k + 1 < param.cols() && fabs(param(0, k)) < 1e-7) k++;
+	double g_r = param(0, k) / max(1, h - 1), g_c = param(1, k) / max(1, w - 1);
+	if (g_c < 0) g_r = -g_r;
+	return acos(g_r / sqrt(g_r * g_r + g_c * g_c));
+}
+
+//<linearGradient> of an object covering the pixels in bbox (min row, min col, max row, max col), built as
+//parse_gradient_tag does: the gradient runs from a bbox corner along the gradient angle to the projection
+//of the opposite corner, and the stops are the layer colors there. It is given in image coordinates
+//(userSpaceOnUse), as the paths are, instead of percentages of potrace's flipped path bbox.
+inline string LinearGradientTag(const MatrixXd& param, Vec4i bbox, int h, int w, string id) {
+	double theta = GradientAngle(param, h, w);
+	Vec2d n(cos(theta), sin(theta));
+	Vec2d start(bbox[0], bbox[1]), end(bbox[2] + 1.0, bbox[3] + 1.0);	//(row, col) pixel corners
+	if (theta >= CV_PI / 2) swap(start[0], end[0]);
+	Vec2d diag = end - start;
+	end = start + n * (diag[0] * n[0] + diag[1] * n[1]);
+
+	//the model evaluates pixel (r, c) at (r / (h - 1), c / (w - 1)), its center is (r + 0.5, c + 0.5)
+	auto color_at = [&](Vec2d p, int k) {
+		double x = (p[0] - 0.5) / max(1, h - 1), y = (p[1] - 0.5) / max(1, w - 1);
+		return clamp(x * param(0, k) + y * param(1, k) + param(2, k), 0.0, 1.0);
+	};
+
+	ostringstream os;
+	os << fixed << setprecision(2);
+	os << "<linearGradient id=\"" << id << "\" gradientUnits=\"userSpaceOnUse\" x1=\"" << start[1] << "\" y1=\"" << start[0]
+		<< "\" x2=\"" << end[1] << "\" y2=\"" << end[0] << "\">";
+	for (int s = 0; s < 2; s++) {
+		Vec2d p = s ? end : start;
+		os << "<stop offset=\"" << (s ? "100%" : "0%") << "\" style=\"stop-color:rgb("
+			<< (int)floor(color_at(p, 0) * 255) << "," << (int)floor(color_at(p, 1) * 255) << "," << (int)floor(color_at(p, 2) * 255)
+			<< ");stop-opacity:" << setprecision(3) << color_at(p, 3) << setprecision(2) << "\" />";
+	}
+	os << "</linearGradient>";
+	return os.str();
+}
+
+inline string SvgPathTag(const string& path_data, string id, string gradient_id) {
+	return "<path id=\"" + id + "\" fill=\"url(#" + gradient_id + ")\" fill-rule=\"evenodd\" d=\"" + path_data + "\"/>";
+}
+
+//<path> of a flat fill object (IsFlatFill), the color is the constant term of param
+inline string FlatFillPathTag(const string& path_data, string id, const MatrixXd& param) {
+	ostringstream os;
+	os << "<path id=\"" << id << "\" fill=\"rgb(";
+	for (int k = 0; k < 3; k++) os << (k ? "," : "") << (int)floor(clamp(param(2, k), 0.0, 1.0) * 255);
+	os << ")\" fill-opacity=\"" << setprecision(3) << clamp(param(2, 3), 0.0, 1.0) << "\" fill-rule=\"evenodd\" d=\"" << path_data << "\"/>";
+	return os.str();
+}
+
+//layer_paths[i]: the <path> tags of layer i + 1, bottom layer first
+inline bool WriteSvgDocument(string path, int h, int w, const vector<string>& gradient_tags, const vector<vector<string>>& layer_paths) {
+	size_t bytes = 512;
+	for (const string& tag : gradient_tags) bytes += tag.size();
+	for (const vector<string>& tags : layer_paths)
+		for (const string& tag : tags) bytes += tag.size() + 32;
+
+	BufferedFileWriter out(bytes);
+	out << "<?xml version=\"1.0\" standalone=\"no\"?>"
+		"<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 20010904//EN\" \"http://www.w3.org/TR/2001/REC-SVG-20010904/DTD/svg10.dtd\">"
+		"<svg version=\"1.0\" xmlns=\"http://www.w3.org/2000/svg\" width=\"" << w << "pt\" height=\"" << h << "pt\" viewBox=\"0 0 "
+		<< w << " " << h << "\" preserveAspectRatio=\"xMidYMid meet\">";
+	out << "<defs>";
+	for (const string& tag : gradient_tags) out << tag;
+	out << "</defs>";
+	for (int i = 0; i < layer_paths.size(); i++) {
+		out << "<g id=\"layer-" << i + 1 << "\">";
+		for (const string& tag : layer_paths[i]) out << tag;
+		out << "</g>";
+	}
+	out << "</svg>\n";
+	return out.WriteTo(path);
+}
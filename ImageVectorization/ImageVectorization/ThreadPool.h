@@ -0,0 +1,149 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <omp.h>
+
+using namespace std;
+
+//Work-stealing thread pool: every worker has its own deque, pops its newest task first and
+//steals the oldest task of another worker when its own deque is empty.
+//Tasks run with a single OpenMP thread, the parallelism comes from the pool.
+class ThreadPool {
+private:
+	struct Worker {
+		mutex				m;
+		deque<function<void()>>	tasks;
+	};
+
+	vector<unique_ptr<Worker>>	m_workers;
+	vector<thread>				m_threads;
+	mutex						m_mutex;
+	condition_variable			m_wake_cv;				//new task or stop
+	condition_variable			m_idle_cv;				//all tasks done
+	atomic<int>					m_pending_cnt{ 0 };		//submitted but not finished
+	atomic<int>					m_queued_cnt{ 0 };		//submitted and not claimed by a worker
+	atomic<unsigned>			m_next_worker{ 0 };
+	bool						m_stop = false;
+
+	static int& CurrentWorker() {
+		static thread_local int worker_id = -1;
+		return worker_id;
+	}
+
+public:
+	ThreadPool(int thread_cnt = 0) {
+		if (thread_cnt <= 0) thread_cnt = max(1u, thread::hardware_concurrency());
+		for (int i = 0; i < thread_cnt; i++)
+			m_workers.push_back(make_unique<Worker>());
+		for (int i = 0; i < thread_cnt; i++)
+			m_threads.emplace_back([this, i] { WorkerLoop(i); });
+	}
+
+	~ThreadPool() {
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake_cv.notify_all();
+		for (thread& t : m_threads) t.join();
+	}
+
+	int ThreadCnt() const {
+		return (int)m_workers.size();
+	}
+
+	//tasks submitted from a worker go to its own deque, others are spread round robin
+	void Submit(function<void()> task) {
+		int id = CurrentWorker();
+		if (id < 0) id = m_next_worker++ % m_workers.size();
+		m_pending_cnt++;
+		{
+			lock_guard<mutex> lock(m_workers[id]->m);
+			m_workers[id]->tasks.push_back(move(task));
+		}
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_queued_cnt++;
+		}
+		m_wake_cv.notify_one();
+	}
+
+	//run body(0) ... body(n - 1) as separate tasks, then() runs once after all of them have finished
+	void ParallelFor(int n, function<void(int)> body, function<void()> then) {
+		if (n <= 0) {
+			Submit(then);
+			return;
+		}
+		auto remaining = make_shared<atomic<int>>(n);
+		for (int i = 0; i < n; i++) {
+			Submit([=] {
+				body(i);
+				if (--(*remaining) == 0) then();
+			});
+		}
+	}
+
+	//block until every submitted task, including the ones they submit, has finished
+	void WaitAll() {
+		unique_lock<mutex> lock(m_mutex);
+		m_idle_cv.wait(lock, [this] { return m_pending_cnt == 0; });
+	}
+
+private:
+	bool TryPop(int id, function<void()>& task) {
+		//own deque, newest first
+		{
+			Worker& w = *m_workers[id];
+			lock_guard<mutex> lock(w.m);
+			if (!w.tasks.empty()) {
+				task = move(w.tasks.back());
+				w.tasks.pop_back();
+				return true;
+			}
+		}
+		//steal the oldest task of another worker
+		for (int k = 1; k < m_workers.size(); k++) {
+			Worker& w = *m_workers[(id + k) % m_workers.size()];
+			lock_guard<mutex> lock(w.m);
+			if (!w.tasks.empty()) {
+				task = move(w.tasks.front());
+				w.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkerLoop(int id) {
+		CurrentWorker() = id;
+		omp_set_num_threads(1);
+
+		while (true) {
+			//claim one queued task; it is pushed before it is counted, so it is in some deque, maybe one
+			//that was already scanned, and only a claimed worker takes it out
+			{
+				unique_lock<mutex> lock(m_mutex);
+				m_wake_cv.wait(lock, [this] { return m_stop || m_queued_cnt > 0; });
+				if (m_queued_cnt == 0) return;
+				m_queued_cnt--;
+			}
+
+			function<void()> task;
+			while (!TryPop(id, task))
+				this_thread::yield();
+			task();
+
+			if (--m_pending_cnt == 0) {
+				lock_guard<mutex> lock(m_mutex);
+				m_idle_cv.notify_all();
+			}
+		}
+	}
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include "MappedFile.h"
+
+using namespace std;
+using namespace cv;
+
+//Tiled input image (input.tiles) for images too large to keep resident: the pixels are stored tile by
+//tile, so the pixels of a region's bbox lie in a few contiguous blocks of the file, and the file is
+//mapped, so only the tiles that are read occupy memory.
+//
+//	header | tile (ty, tx) at header + (ty * tiles_x + tx) * 3 * T * T: R, G and B planes of T x T
+//	bytes; the tiles on the right and bottom edges are padded with zeros
+
+#define TILED_IMAGE_MAGIC	0x454C4954	//"TILE"
+#define TILED_IMAGE_VERSION	1
+
+struct TiledImageHeader {
+	uint32_t magic = TILED_IMAGE_MAGIC;
+	uint32_t version = TILED_IMAGE_VERSION;
+	int32_t h = 0, w = 0, tile_size = 0, tiles_x = 0, tiles_y = 0, reserved = 0;
+};
+
+class TiledImage {
+private:
+	MappedFile m_file;
+	const uchar* m_tiles = nullptr;
+
+public:
+	int h = 0, w = 0, tile_size = 0, tiles_x = 0, tiles_y = 0;
+
+public:
+	//write an 8-bit BGR image as tiles, one row of tiles at a time
+	static bool Write(const Mat& img, string path, int tile_size) {
+		if (img.empty() || tile_size <= 0) return false;
+		TiledImageHeader hd;
+		hd.h = img.rows, hd.w = img.cols, hd.tile_size = tile_size;
+		hd.tiles_x = (img.cols + tile_size - 1) / tile_size;
+		hd.tiles_y = (img.rows + tile_size - 1) / tile_size;
+
+		FILE* fp = fopen(path.c_str(), "wb");
+		if (!fp) return false;
+		bool ok = fwrite(&hd, sizeof(hd), 1, fp) == 1;
+
+		size_t plane = (size_t)tile_size * tile_size, tile_bytes = 3 * plane;
+		vector<uchar> band(tile_bytes * hd.tiles_x);
+		int c = img.channels();
+		for (int ty = 0; ok && ty < hd.tiles_y; ty++) {
+			fill(band.begin(), band.end(), 0);
+			for (int r = ty * tile_size; r < min(img.rows, (ty + 1) * tile_size); r++) {
+				const uchar* data = img.ptr<uchar>(r);
+				size_t in_tile_row = (size_t)(r - ty * tile_size) * tile_size;
+				for (int col = 0; col < img.cols; col++) {
+					uchar* tile = band.data() + (col / tile_size) * tile_bytes + in_tile_row + col % tile_size;
+					tile[0] = data[c * col + 2], tile[plane] = data[c * col + 1], tile[2 * plane] = data[c * col];
+				}
+			}
+			ok = fwrite(band.data(), 1, band.size(), fp) == band.size();
+		}
+		return fclose(fp) == 0 && ok;
+	}
+
+	//true if path holds tiles of tile_size that are not older than the image they were made from
+	static bool IsCurrent(string path, string image_path, int tile_size) {
+		error_code ec;
+		auto tiles_time = filesystem::last_write_time(path, ec);
+		if (ec) return false;
+		auto image_time = filesystem::last_write_time(image_path, ec);
+		if (ec || tiles_time < image_time) return false;
+
+		TiledImageHeader hd;
+		FILE* fp = fopen(path.c_str(), "rb");
+		if (!fp) return false;
+		bool ok = fread(&hd, sizeof(hd), 1, fp) == 1;
+		fclose(fp);
+		return ok && hd.magic == TILED_IMAGE_MAGIC && hd.version == TILED_IMAGE_VERSION && hd.tile_size == tile_size;
+	}
+
+	bool Open(string path) {
+		m_file.Close();
+		m_tiles = nullptr;
+		TiledImageHeader hd;
+		if (!m_file.Open(path) || m_file.Size() < sizeof(hd)) return false;
+		memcpy(&hd, m_file.Data(), sizeof(hd));
+		size_t tile_bytes = 3 * (size_t)hd.tile_size * hd.tile_size;
+		if (hd.magic != TILED_IMAGE_MAGIC || hd.version != TILED_IMAGE_VERSION || hd.tile_size <= 0 ||
+			sizeof(hd) + tile_bytes * hd.tiles_x * hd.tiles_y > m_file.Size()) {
+			cout << "invalid tiled image: " << path << endl;
+			m_file.Close();
+			return false;
+		}
+		h = hd.h, w = hd.w, tile_size = hd.tile_size, tiles_x = hd.tiles_x, tiles_y = hd.tiles_y;
+		m_tiles = (const uchar*)m_file.Data() + sizeof(hd);
+		return true;
+	}
+
+	int TileCnt() const { return tiles_x * tiles_y; }
+
+	int TileOf(int row, int col) const {
+		return row / tile_size * tiles_x + col / tile_size;
+	}
+
+	//(min row, min col, max row, max col) of a tile, clipped to the image
+	Vec4i TileRect(int tile) const {
+		int r0 = tile / tiles_x * tile_size, c0 = tile % tiles_x * tile_size;
+		return Vec4i(r0, c0, min(h, r0 + tile_size) - 1, min(w, c0 + tile_size) - 1);
+	}
+
+	//R of the pixel; G and B follow at PlaneStride() and 2 * PlaneStride()
+	const uchar* Pixel(int row, int col) const {
+		size_t tile = TileOf(row, col);
+		return m_tiles + tile * 3 * tile_size * tile_size + (size_t)(row % tile_size) * tile_size + col % tile_size;
+	}
+
+	size_t PlaneStride() const {
+		return (size_t)tile_size * tile_size;
+	}
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+//The k results of the lowest loss seen so far, pushed by concurrent workers as soon as they finish. A result
+//that does not make the top k is freed right away, and so is one pushed out by a better result, so at most
+//k results are alive at any time. Ties in the loss go to the lower id, so the kept set does not depend on
+//the order the results arrive in.
+template<typename T>
+class TopKResults {
+private:
+	struct Entry {
+		double	loss;
+		int		id;
+		T		item;
+	};
+
+	size_t			m_k;
+	vector<Entry>	m_heap;				//heap with the worst kept result on top
+	mutex			m_mutex;
+	atomic<double>	m_threshold;
+	int				m_pushed_cnt = 0;
+	int				m_dropped_cnt = 0;
+
+	static bool Better(const Entry& a, const Entry& b) {
+		return a.loss != b.loss ? a.loss < b.loss : a.id < b.id;
+	}
+
+public:
+	TopKResults(size_t k = 1) : m_k(k), m_threshold(numeric_limits<double>::infinity()) {}
+
+	void Reset(size_t k) {
+		lock_guard<mutex> lock(m_mutex);
+		m_k = k;
+		vector<Entry>().swap(m_heap);
+		m_threshold = numeric_limits<double>::infinity();
+		m_pushed_cnt = m_dropped_cnt = 0;
+	}
+
+	//the loss a result has to beat to be kept: the k-th lowest so far, infinity while fewer than k are kept
+	double Threshold() const {
+		return m_threshold.load(memory_order_relaxed);
+	}
+
+	//false if the result was dropped; the item is moved from in either case
+	bool Push(double loss, int id, T&& item) {
+		Entry dropped{ loss, id, move(item) };	//destroyed after the lock is released
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_pushed_cnt++;
+			if (m_k == 0 || (m_heap.size() == m_k && !Better(dropped, m_heap.front()))) {
+				m_dropped_cnt++;
+				return false;
+			}
+			m_heap.push_back(move(dropped));
+			push_heap(m_heap.begin(), m_heap.end(), Better);
+			if (m_heap.size() > m_k) {
+				pop_heap(m_heap.begin(), m_heap.end(), Better);
+				dropped = move(m_heap.back());
+				m_heap.pop_back();
+				m_dropped_cnt++;
+			}
+			if (m_heap.size() == m_k) m_threshold = m_heap.front().loss;
+		}
+		return true;
+	}
+
+	int PushedCnt() { lock_guard<mutex> lock(m_mutex); return m_pushed_cnt; }
+	int DroppedCnt() { lock_guard<mutex> lock(m_mutex); return m_dropped_cnt; }
+
+	//the kept results from the lowest loss up, the container is left empty
+	vector<T> TakeSorted() {
+		lock_guard<mutex> lock(m_mutex);
+		sort_heap(m_heap.begin(), m_heap.end(), Better);
+		vector<T> items;
+		items.reserve(m_heap.size());
+		for (Entry& e : m_heap) items.push_back(move(e.item));
+		vector<Entry>().swap(m_heap);
+		m_threshold = numeric_limits<double>::infinity();
+		return items;
+	}
+};
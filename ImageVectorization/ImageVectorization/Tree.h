@@ -2,6 +2,8 @@
 
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include <map>
+#include <set>
 
 using namespace cv;
 using namespace std;
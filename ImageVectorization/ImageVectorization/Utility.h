@@ -2,43 +2,137 @@
 
 #include <vector>
 #include <queue>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <filesystem>
 #include <opencv2/opencv.hpp>
 #include <Eigen/Core>
+#include "TiledImage.h"
 using namespace cv;
 using namespace std;
 using namespace Eigen;
 
+enum ImageStorage {
+	IMG_STORAGE_U8,		//8-bit planes, lossless for the 8-bit png inputs
+	IMG_STORAGE_F32,	//float planes in [0, 1]
+	IMG_STORAGE_TILED	//8-bit tiles of a mapped input.tiles, see TiledImage.h
+};
+
+//planar R, G, B image, copies share the pixel planes
 struct ImageObj {
-	vector<Vec3d> colors;
-	int h, w, c;
+	int h = 0, w = 0, c = 0;
+	int stride = 0;								//row stride of a plane, in elements
+	ImageStorage storage = IMG_STORAGE_U8;
+	shared_ptr<vector<uchar>> u8_planes;
+	shared_ptr<vector<float>> f32_planes;
+	shared_ptr<TiledImage> tiles;
 
 	ImageObj() { }
+
+	ImageObj(shared_ptr<TiledImage> tiles_) {
+		tiles = tiles_;
+		h = tiles->h, w = tiles->w, c = 3;
+		storage = IMG_STORAGE_TILED;
+	}
 	ImageObj(vector<Vec3d>& colors_, int h_, int w_, int c_) {
-		colors = colors_;
 		h = h_, w = w_, c = c_;
+		Allocate(IMG_STORAGE_F32);
+		float* data = f32_planes->data();
+		size_t n = PlaneSize();
+		for (int row = 0; row < h; row++) {
+			for (int col = 0; col < w; col++) {
+				Vec3d& color = colors_[row * w + col];
+				size_t k = (size_t)row * stride + col;
+				data[k] = color[0], data[n + k] = color[1], data[2 * n + k] = color[2];
+			}
+		}
 	}
 
-	ImageObj(string path) {
-		cv::Mat img = cv::imread(path);
+	ImageObj(string path, ImageStorage storage_ = IMG_STORAGE_U8) : ImageObj(cv::imread(path), storage_) { }
+
+	//8-bit BGR image as read by imread
+	ImageObj(const cv::Mat& img, ImageStorage storage_ = IMG_STORAGE_U8) {
 		h = img.rows;
 		w = img.cols;
 		c = img.channels();
-		colors.clear();
-		colors.resize(h * w);
+		Allocate(storage_);
+		size_t n = PlaneSize();
 
-		//read the original image pixels
+		//read the original image pixels, BGR -> R, G, B planes
 #pragma omp parallel for
 		for (int row = 0; row < h; row++) {
-			uchar* data = img.ptr<uchar>(row);
-			for (int col = 0; col < w; col++) {
-				uchar B = data[c * col + 0];
-				uchar G = data[c * col + 1];
-				uchar R = data[c * col + 2];
-				Vec3d color(R / 255.0, G / 255.0, B / 255.0);
-				int k = row * w + col;
-				colors[k] = color;
+			const uchar* data = img.ptr<uchar>(row);
+			size_t k = (size_t)row * stride;
+			if (storage == IMG_STORAGE_U8) {
+				uchar* R = u8_planes->data() + k;
+				uchar* G = R + n;
+				uchar* B = G + n;
+				for (int col = 0; col < w; col++) {
+					B[col] = data[c * col + 0];
+					G[col] = data[c * col + 1];
+					R[col] = data[c * col + 2];
+				}
 			}
+			else {
+				float* R = f32_planes->data() + k;
+				float* G = R + n;
+				float* B = G + n;
+				for (int col = 0; col < w; col++) {
+					B[col] = data[c * col + 0] / 255.0f;
+					G[col] = data[c * col + 1] / 255.0f;
+					R[col] = data[c * col + 2] / 255.0f;
+				}
+			}
+		}
+	}
+
+	void Allocate(ImageStorage storage_) {
+		storage = storage_;
+		stride = (w + 15) / 16 * 16;
+		if (storage == IMG_STORAGE_U8)
+			u8_planes = make_shared<vector<uchar>>(3 * PlaneSize(), 0);
+		else
+			f32_planes = make_shared<vector<float>>(3 * PlaneSize(), 0.0f);
+	}
+
+	size_t PlaneSize() const {
+		return (size_t)h * stride;
+	}
+
+	//color in [0, 1], the only place the planes are converted to double
+	Vec3d GetColor(int row, int col) const {
+		if (storage == IMG_STORAGE_TILED) {
+			const uchar* p = tiles->Pixel(row, col);
+			size_t n = tiles->PlaneStride();
+			return Vec3d(p[0] / 255.0, p[n] / 255.0, p[2 * n] / 255.0);
 		}
+		size_t n = PlaneSize(), k = (size_t)row * stride + col;
+		if (storage == IMG_STORAGE_U8) {
+			const uchar* data = u8_planes->data();
+			return Vec3d(data[k] / 255.0, data[n + k] / 255.0, data[2 * n + k] / 255.0);
+		}
+		const float* data = f32_planes->data();
+		return Vec3d(data[k], data[n + k], data[2 * n + k]);
+	}
+
+	Vec3d GetColor(int pid) const {
+		return GetColor(pid / w, pid % w);
+	}
+
+	//color in [0, 255]
+	Vec3i GetColor255(int pid) const {
+		if (storage == IMG_STORAGE_TILED) {
+			const uchar* p = tiles->Pixel(pid / w, pid % w);
+			size_t n = tiles->PlaneStride();
+			return Vec3i(p[0], p[n], p[2 * n]);
+		}
+		size_t n = PlaneSize(), k = (size_t)(pid / w) * stride + pid % w;
+		if (storage == IMG_STORAGE_U8) {
+			const uchar* data = u8_planes->data();
+			return Vec3i(data[k], data[n + k], data[2 * n + k]);
+		}
+		return GetColor(pid) * 255;
 	}
 
 	double operator -(Mat& img1) {
@@ -50,30 +144,11 @@ struct ImageObj {
 				uchar G = data[c * col + 1];
 				uchar R = data[c * col + 2];
 				Vec3d color(R / 255.0, G / 255.0, B / 255.0);
-				int k = row * w + col;
-				diff += norm(color - this->colors[k], NORM_L1);
+				diff += norm(color - GetColor(row, col), NORM_L1);
 			}
 		}
 		return diff;
 	}
-
-	//include those outside the boundary
-	//Vec2i(a,b): a = 1:inside, a = 0:boundary, b is the pid
-	vector<Vec2i> GetAllNeighbors(int pos) {
-		int r = pos / w, c = pos % w;
-		int r_[8] = { -1,0,1,0,-1,1,-1,1 };
-		int c_[8] = { 0,1,0,-1,-1,1,1,-1 };
-		vector<Vec2i> nb;
-		for (int i = 0; i < 8; i++) {
-			int new_r = r + r_[i];
-			int new_c = c + c_[i];
-			if (0 <= new_r && new_r < h && 0 <= new_c && new_c < w)
-				nb.push_back(Vec2i(1, new_r * w + new_c));
-			else
-				nb.push_back(Vec2i(0, new_r * w + new_c));
-		}
-		return nb;
-	}
 };
 
 
@@ -106,21 +181,25 @@ struct vec4icmp {
 	}
 };
 
+//create a directory and its missing parents, nothing happens if it exists
+inline bool CreateDirectories(const string& dir) {
+	error_code ec;
+	filesystem::create_directories(filesystem::path(dir), ec);
+	return !ec;
+}
+
+//16 x 16 squares, gray (210) where the row and column square indices sum to an even number, else white;
+//each row is copied from one of two precomputed rows
 inline Mat GetChessboard(int h = 128, int w = 128) {
 	int grid_len = 16;
-	Mat img(h, w, CV_8UC3, Scalar(255, 255, 255));
-	int k = 0;
-	for (int r = 0; r < h; r += grid_len) {
-		k = r / grid_len % 2;
-		for (int c = 0; c < w; c += grid_len) {
-			if (k++ % 2 == 1) continue;
-			for (int r_ = r; r_ < min(r + grid_len, h); r_++)
-				for (int c_ = c; c_ < min(c + grid_len, w); c_++) {
-					img.at<cv::Vec3b>(r_, c_)[0] = 210;
-					img.at<cv::Vec3b>(r_, c_)[1] = 210;
-					img.at<cv::Vec3b>(r_, c_)[2] = 210;
-				}
-		}
+	Mat img(h, w, CV_8UC3);
+	vector<uchar> rows[2];
+	for (int k = 0; k < 2; k++) {
+		rows[k].resize((size_t)w * 3);
+		for (int c = 0; c < w; c++)
+			rows[k][3 * c] = rows[k][3 * c + 1] = rows[k][3 * c + 2] = (c / grid_len + k) % 2 ? 255 : 210;
 	}
+	for (int r = 0; r < h; r++)
+		memcpy(img.ptr(r), rows[r / grid_len % 2].data(), rows[0].size());
 	return img;
 }
\ No newline at end of file
@@ -1,8 +1,5 @@
 ﻿
-#include "Utility.h"
 #include <iostream>
-#include <direct.h>
-#include <io.h>
 #include "RegionInfo.h"
 
 int main() { 
@@ -20,12 +17,11 @@ int main() {
         string output_region_path = data_dir + "/region.png";
         string output_param_path = data_dir + "/region_info.txt";
         string output_region_ind_path = data_dir + "/region_index.png";
+        string output_region_store_path = data_dir + "/region.bin";
 
         RegionInfo Ri(input_img_path, input_seg_path,input_mask);
-        Ri.OutputRegionInfo_s1(output_region_path, output_param_path, output_region_ind_path);
-        Ri.GetAdjacencyInfo(output_param_path);
-        Ri.GetXjunctionInfo(output_param_path);
-        Ri.OutputRegionInfo_s2(output_param_path);
+        Ri.OutputRegionInfo(output_region_path, output_param_path, output_region_ind_path);
+        Ri.OutputRegionStore(output_region_store_path);
     }
     return 0;
 }
\ No newline at end of file